@@ -0,0 +1,33 @@
+/**
+ * @file accumulator.h
+ *
+ * The first layer of the leaf evaluation network, kept separate from
+ * nnue.h so that a Board can hold one without depending on the network.
+ */
+
+#ifndef ACCUMULATOR_H_
+#define ACCUMULATOR_H_
+
+#include <cstdint>
+
+namespace breakthrough {
+
+/**
+ * The number of first-layer neurons for each perspective.
+ */
+constexpr int nnue_hidden = 32;
+
+/**
+ * The first-layer outputs of the network, from the perspective of white
+ * (index 0) and black (index 1).
+ *
+ * Moving a piece only changes a few input features, so this is updated
+ * incrementally when a move is played rather than recomputed.
+ */
+struct alignas(32) Accumulator {
+    int16_t values[2][nnue_hidden];
+};
+
+}  // namespace breakthrough
+
+#endif // ACCUMULATOR_H_
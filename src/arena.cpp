@@ -0,0 +1,135 @@
+#include "arena.h"
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace breakthrough {
+
+namespace {
+
+constexpr std::size_t huge_page_size = 2 << 20;
+
+/**
+ * From <numaif.h>, which is not installed everywhere: prefer the given
+ * node, falling back to the others when it is full, or interleave the
+ * pages over the given nodes.
+ */
+constexpr int mpol_preferred = 1;
+constexpr int mpol_interleave = 3;
+
+std::size_t round_up(std::size_t bytes, std::size_t multiple) {
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+/**
+ * The NUMA node of the CPU the calling thread runs on, -1 if unknown.
+ */
+int current_numa_node() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
+
+/**
+ * Ask for the pages of the block to be placed as given. On machines or
+ * kernels without NUMA support this fails, and the pages are placed as
+ * usual.
+ */
+void place_pages(void* data, std::size_t size, NumaPlacement placement) {
+    unsigned long mask;
+    int mode;
+    if (placement == NumaPlacement::Interleaved) {
+        // The kernel ignores the nodes the machine does not have
+        mask = ~0ul >> 1;
+        mode = mpol_interleave;
+    } else {
+        const int node = current_numa_node();
+        if (node < 0 || node >= 63) {
+            return;
+        }
+        mask = 1ul << node;
+        mode = mpol_preferred;
+    }
+    // The kernel reads one bit less than the given maximum node
+    syscall(SYS_mbind, data, size, mode, &mask, sizeof(mask) * 8, 0u);
+}
+
+}  // namespace
+
+MemoryArena::MemoryArena(std::size_t bytes, NumaPlacement placement) {
+    if (bytes == 0) {
+        return;
+    }
+    m_size = round_up(bytes, huge_page_size);
+
+    // Reserved huge pages, only there if the administrator set some aside
+    void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+        m_reserved = true;
+    } else {
+        // Regular pages, over-allocated to trim them to a huge page
+        // boundary so that transparent huge pages can cover the block
+        const std::size_t mapped = m_size + huge_page_size;
+        data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            m_size = 0;
+            throw std::bad_alloc();
+        }
+        const auto start = reinterpret_cast<uintptr_t>(data);
+        const uintptr_t aligned = round_up(start, huge_page_size);
+        if (aligned > start) {
+            munmap(data, aligned - start);
+        }
+        if (start + mapped > aligned + m_size) {
+            munmap(reinterpret_cast<void*>(aligned + m_size), start + mapped - aligned - m_size);
+        }
+        data = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        madvise(data, m_size, MADV_HUGEPAGE);
+#endif
+    }
+    m_data = data;
+
+    // Nothing is touched yet, so every page will be placed as asked
+    place_pages(m_data, m_size, placement);
+}
+
+MemoryArena::~MemoryArena() {
+    release();
+}
+
+MemoryArena::MemoryArena(MemoryArena&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_reserved(std::exchange(other.m_reserved, false))
+{
+}
+
+MemoryArena& MemoryArena::operator=(MemoryArena&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_reserved = std::exchange(other.m_reserved, false);
+    }
+    return *this;
+}
+
+void MemoryArena::release() {
+    if (m_data) {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
+
+}  // namespace breakthrough
@@ -0,0 +1,80 @@
+/**
+ * @file arena.h
+ *
+ * Large blocks of memory for the search tables, mapped directly with mmap.
+ *
+ * The tables are probed at random, so with regular 4 KiB pages nearly
+ * every probe misses the TLB. The block is backed by huge pages when the
+ * system has some reserved, and otherwise asks for transparent huge
+ * pages.
+ *
+ * On NUMA machines, a block used by a single thread, or by a process
+ * pinned to one node (see shared.h), is placed on the node of the thread
+ * that creates it. A block used by several unpinned threads, which may
+ * run on any node, is interleaved over all of them instead.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+
+namespace breakthrough {
+
+/**
+ * Where the pages of a block go on a NUMA machine.
+ */
+enum class NumaPlacement {
+    /**
+     * On the node of the thread that creates the block.
+     */
+    Local,
+
+    /**
+     * Spread evenly over every node.
+     */
+    Interleaved,
+};
+
+class MemoryArena {
+public:
+    MemoryArena() = default;
+
+    /**
+     * Map at least the given number of zeroed bytes, aligned on a huge
+     * page. Throws std::bad_alloc if the memory cannot be mapped.
+     */
+    explicit MemoryArena(std::size_t bytes, NumaPlacement placement = NumaPlacement::Local);
+
+    /**
+     * Unmap the whole block at once.
+     */
+    ~MemoryArena();
+
+    MemoryArena(MemoryArena&& other) noexcept;
+    MemoryArena& operator=(MemoryArena&& other) noexcept;
+
+    void* data() const { return m_data; }
+
+    /**
+     * The size of the block, rounded up to whole huge pages.
+     */
+    std::size_t size() const { return m_size; }
+
+    /**
+     * Check if the block is backed by reserved huge pages rather than
+     * by transparent ones, which the kernel may or may not provide.
+     */
+    bool reserved_huge_pages() const { return m_reserved; }
+
+private:
+    void release();
+
+    void* m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_reserved{false};
+};
+
+}  // namespace breakthrough
+
+#endif // ARENA_H_
@@ -1,12 +1,15 @@
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <charconv>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <optional>
 #include <system_error>
 #include "board.h"
+#include "nnue.h"
 #include "zobrist.h"
 
 namespace breakthrough {
@@ -23,8 +26,11 @@ constexpr auto to_int = [](std::string_view sv) -> std::optional<int> {
 
 /**
  * Used for updating the hash value.
+ *
+ * The seed is fixed so that hashes, and hence searches, are the same
+ * from one run to the next.
  */
-Zobrist zobrist;
+Zobrist zobrist{0x9E3779B9u};
 
 inline uint64_t get_hash(Square square, Piece piece) {
     if (is_empty(piece)) {
@@ -45,22 +51,46 @@ void init_zobrist() {
     assert(zobrist.size() == 128 && "Zobrist table not of size 128 after initialization");
 }
 
+/**
+ * Initialize the zobrist table exactly once, even when boards are
+ * first created concurrently from several threads.
+ */
+void ensure_zobrist() {
+    static const bool initialized = (init_zobrist(), true);
+    (void)initialized;
+}
+
+inline uint64_t get_mirror_hash(Square square, Piece piece) {
+    return get_hash(square ^ 7, piece);
+}
+
+void check_pawn_count(uint64_t white, uint64_t black) {
+    if (std::popcount(white) > max_pawns || std::popcount(black) > max_pawns) {
+        throw std::invalid_argument("more than " + std::to_string(max_pawns) + " pawns of one color");
+    }
+}
+
+inline uint64_t& bitboard_of(Piece piece, uint64_t& white, uint64_t& black) {
+    return is_white(piece) ? white : black;
+}
+
 }  // namespace
 
 Board::Board() {
     std::fill_n(m_squares.begin(), 16, Piece::WHITE);
     std::fill_n(m_squares.begin() + 16, 32, Piece::EMPTY);
     std::fill_n(m_squares.rbegin(), 16, Piece::BLACK);
+    m_white = 0xFFFFull;
+    m_black = 0xFFFFull << 48;
 
-    if (zobrist.size() == 0) {
-        init_zobrist();
-    }
+    ensure_zobrist();
 
     // Initialize the position hash
     for (int i = 0; i < 16; ++i) {
         m_hash ^= get_hash(i, Piece::WHITE);
         m_hash ^= get_hash(63 - i, Piece::BLACK);
     }
+    m_mirror_hash = m_hash;
 }
 
 Board::Board(std::istream& fen) {
@@ -68,20 +98,28 @@ Board::Board(std::istream& fen) {
     std::getline(fen, buf, ' ');
 
     auto square = m_squares.begin();
+    auto place = [&](Piece piece) {
+        if (square == m_squares.end()) {
+            throw std::invalid_argument("more than 64 squares in the fen string");
+        }
+        *square++ = piece;
+    };
     for (auto c : buf) {
         if (c == '/') {
             continue;
         }
         if (c == 'P') {
-            *square++ = Piece::WHITE;
+            place(Piece::WHITE);
         } else if (c == 'p') {
-            *square++ = Piece::BLACK;
+            place(Piece::BLACK);
         } else {
-            for (auto i = 0; i < to_int(&c); ++i) {
-                *square++ = Piece::EMPTY;
+            const int n_empty = to_int(std::string_view(&c, 1)).value_or(0);
+            for (auto i = 0; i < n_empty; ++i) {
+                place(Piece::EMPTY);
             }
         }
     }
+    std::fill(square, m_squares.end(), Piece::EMPTY);
 
     std::getline(fen, buf, ' ');
     auto black_to_play = buf[0] == 'b';
@@ -93,12 +131,37 @@ Board::Board(std::istream& fen) {
 
     m_ply = (full_moves - 1) * 2 + black_to_play;
 
-    if (zobrist.size() == 0) {
-        init_zobrist();
+    ensure_zobrist();
+
+    for (int i = 0; i < 64; ++i) {
+        m_hash ^= get_hash(i, m_squares[i]);
+        m_mirror_hash ^= get_mirror_hash(i, m_squares[i]);
+        if (is_white(m_squares[i])) {
+            m_white |= 1ull << i;
+        } else if (is_black(m_squares[i])) {
+            m_black |= 1ull << i;
+        }
     }
 
+    check_pawn_count(m_white, m_black);
+}
+
+Board::Board(uint64_t white, uint64_t black, int ply)
+    : m_white{white}, m_black{black}, m_ply{ply}
+{
+    check_pawn_count(white, black);
+    ensure_zobrist();
+
     for (int i = 0; i < 64; ++i) {
+        if (white & (1ull << i)) {
+            m_squares[i] = Piece::WHITE;
+        } else if (black & (1ull << i)) {
+            m_squares[i] = Piece::BLACK;
+        } else {
+            m_squares[i] = Piece::EMPTY;
+        }
         m_hash ^= get_hash(i, m_squares[i]);
+        m_mirror_hash ^= get_mirror_hash(i, m_squares[i]);
     }
 }
 
@@ -142,11 +205,92 @@ std::string Board::fen() const {
     return ss.str();
 }
 
+Board::Board(const Board& other) {
+    *this = other;
+}
+
+Board& Board::operator=(const Board& other) {
+    if (this == &other) {
+        return *this;
+    }
+    copy_position(other);
+    m_network = other.m_network;
+
+    // Keep our accumulator's memory if there is one
+    if (other.m_accumulator) {
+        if (!m_accumulator) {
+            m_accumulator = std::make_unique<Accumulator>();
+        }
+        *m_accumulator = *other.m_accumulator;
+    } else {
+        m_accumulator.reset();
+    }
+    return *this;
+}
+
+void Board::set_position(const Board& other) {
+    if (this == &other) {
+        return;
+    }
+    copy_position(other);
+    if (m_network) {
+        m_network->refresh(m_squares, *m_accumulator);
+    }
+}
+
+void Board::copy_position(const Board& other) {
+    m_squares = other.m_squares;
+    m_hash = other.m_hash;
+    m_mirror_hash = other.m_mirror_hash;
+    m_white = other.m_white;
+    m_black = other.m_black;
+    m_ply = other.m_ply;
+}
+
+void Board::set_network(const Network* network) {
+    m_network = network;
+    if (!m_network) {
+        m_accumulator.reset();
+        return;
+    }
+    if (!m_accumulator) {
+        m_accumulator = std::make_unique<Accumulator>();
+    }
+    m_network->refresh(m_squares, *m_accumulator);
+}
+
+uint64_t Board::hash_after(Move move) const {
+    return m_hash
+        ^ get_hash(move.source, m_squares[move.source])
+        ^ get_hash(move.target, m_squares[move.target])
+        ^ get_hash(move.target, m_squares[move.source]);
+}
+
+uint64_t Board::canonical_hash_after(Move move) const {
+    const uint64_t mirror_hash = m_mirror_hash
+        ^ get_mirror_hash(move.source, m_squares[move.source])
+        ^ get_mirror_hash(move.target, m_squares[move.target])
+        ^ get_mirror_hash(move.target, m_squares[move.source]);
+    return std::min(hash_after(move), mirror_hash);
+}
+
 void Board::play(Move move) {
-    // Update the hash value
-    m_hash ^= get_hash(move.source, m_squares[move.source]);
-    m_hash ^= get_hash(move.target, m_squares[move.target]);
-    m_hash ^= get_hash(move.target, m_squares[move.source]);
+    // Update the network's first layer
+    if (m_network) {
+        m_network->move(*m_accumulator, move, m_squares[move.source], m_squares[move.target]);
+    }
+
+    // Update the hash values
+    m_mirror_hash ^= get_mirror_hash(move.source, m_squares[move.source])
+        ^ get_mirror_hash(move.target, m_squares[move.target])
+        ^ get_mirror_hash(move.target, m_squares[move.source]);
+    m_hash = hash_after(move);
+
+    // Update the bitboards
+    if (!is_empty(m_squares[move.target])) {
+        bitboard_of(m_squares[move.target], m_white, m_black) ^= 1ull << move.target;
+    }
+    bitboard_of(m_squares[move.source], m_white, m_black) ^= (1ull << move.source) | (1ull << move.target);
 
     // Update the board
     m_squares[move.target] = m_squares[move.source];
@@ -156,6 +300,31 @@ void Board::play(Move move) {
     ++m_ply;
 }
 
+void Board::unmake(Move move, Piece captured) {
+    const Piece piece = m_squares[move.target];
+
+    if (m_network) {
+        m_network->unmove(*m_accumulator, move, piece, captured);
+    }
+
+    m_hash ^= get_hash(move.target, piece);
+    m_hash ^= get_hash(move.target, captured);
+    m_hash ^= get_hash(move.source, piece);
+    m_mirror_hash ^= get_mirror_hash(move.target, piece);
+    m_mirror_hash ^= get_mirror_hash(move.target, captured);
+    m_mirror_hash ^= get_mirror_hash(move.source, piece);
+
+    bitboard_of(piece, m_white, m_black) ^= (1ull << move.source) | (1ull << move.target);
+    if (!is_empty(captured)) {
+        bitboard_of(captured, m_white, m_black) ^= 1ull << move.target;
+    }
+
+    m_squares[move.source] = piece;
+    m_squares[move.target] = captured;
+
+    --m_ply;
+}
+
 bool Board::is_terminal() const {
     const bool black_to_play = m_ply & 1;
     return (black_to_play && std::any_of(m_squares.end() - 8, m_squares.end(), is_white)) ||
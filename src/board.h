@@ -15,9 +15,14 @@
 #ifndef BOARD_H_
 #define BOARD_H_
 
+#include "accumulator.h"
+
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
+#include <string>
 
 namespace breakthrough {
 
@@ -73,6 +78,27 @@ struct Move {
     Square target;
 };
 
+/**
+ * The same move on the board mirrored left to right.
+ */
+inline Move mirror(Move move) {
+    return Move{move.source ^ 7, move.target ^ 7};
+}
+
+/**
+ * The most pawns a side can have.
+ */
+constexpr int max_pawns = 16;
+
+/**
+ * The most valid moves a position can have, 3 for each pawn of the side
+ * to move. Boards are never created with more pawns, so arrays of this
+ * size hold the moves of any position.
+ */
+constexpr int max_moves = 3 * max_pawns;
+
+class Network;
+
 class Board {
 public:
     /**
@@ -82,9 +108,28 @@ public:
 
     /**
      * Create a game with position given by a fen string.
+     *
+     * Throws std::invalid_argument if the string has more than 64
+     * squares or a side has more than `max_pawns`.
      */
     explicit Board(std::istream& fen);
 
+    /**
+     * Create a game with the pieces given by bitboards, where bit `i`
+     * is set if square `i` holds a piece of that color.
+     *
+     * Throws std::invalid_argument if a side has more than `max_pawns`.
+     */
+    Board(uint64_t white, uint64_t black, int ply);
+
+    /**
+     * Copies have their own accumulator, if the original has one.
+     */
+    Board(const Board& other);
+    Board& operator=(const Board& other);
+    Board(Board&& other) noexcept = default;
+    Board& operator=(Board&& other) noexcept = default;
+
     /**
      * Play the given move.
      *
@@ -92,6 +137,13 @@ public:
      */
     void play(Move move);
 
+    /**
+     * Take back the last move, given the piece it captured (EMPTY if none).
+     *
+     * The captured piece is `at(move.target)` before the move is played.
+     */
+    void unmake(Move move, Piece captured);
+
     /**
      * Check if the game is over.
      */
@@ -112,17 +164,74 @@ public:
      */
     uint64_t hash() const { return m_hash; }
 
+    /**
+     * The hash of the position after the given move, without playing it.
+     */
+    uint64_t hash_after(Move move) const;
+
+    /**
+     * The hash of the position mirrored left to right, which has the same
+     * value.
+     */
+    uint64_t mirror_hash() const { return m_mirror_hash; }
+
+    /**
+     * The same hash for the position and its mirror image.
+     */
+    uint64_t canonical_hash() const { return std::min(m_hash, m_mirror_hash); }
+
+    /**
+     * The canonical hash of the position after the given move, without
+     * playing it.
+     */
+    uint64_t canonical_hash_after(Move move) const;
+
     /**
      * Access the whole board
      */
     const std::array<Piece, 64>& squares() const { return m_squares; }
 
+    /**
+     * The bitboard of the squares holding a piece of the given color.
+     */
+    uint64_t bitboard(Piece piece) const { return is_white(piece) ? m_white : m_black; }
+
     /**
      * Construct the fen string of the current position.
      */
     std::string fen() const;
 
+    /**
+     * The network whose first layer is maintained in `accumulator()`, if
+     * any. Boards are created without one.
+     */
+    const Network* network() const { return m_network; }
+
+    /**
+     * Maintain the accumulator for the given network from now on, or
+     * stop maintaining it if nullptr.
+     */
+    void set_network(const Network* network);
+
+    /**
+     * The first layer of `network()` for the current position. Only
+     * valid while the network is set.
+     */
+    const Accumulator& accumulator() const { return *m_accumulator; }
+
+    /**
+     * Take the position of another board, but keep our own network.
+     * Copying a board whose network is not needed this way skips
+     * allocating and updating an accumulator for it.
+     */
+    void set_position(const Board& other);
+
 private:
+    /**
+     * Copy everything but the network and accumulator.
+     */
+    void copy_position(const Board& other);
+
     /**
      * The piece value of each square of the board.
      */
@@ -133,10 +242,29 @@ private:
      */
     uint64_t m_hash{0};
 
+    /**
+     * The hash value of the mirrored position: the same Zobrist values
+     * taken on the mirrored squares.
+     */
+    uint64_t m_mirror_hash{0};
+
+    /**
+     * The bitboards of the white and black pieces.
+     */
+    uint64_t m_white{0};
+    uint64_t m_black{0};
+
     /**
      * The current ply (half-move) of the game.
      */
     int m_ply{0};
+
+    /**
+     * The network's first layer for the current position, only allocated
+     * while `m_network` is set so that other boards stay cheap to copy.
+     */
+    const Network* m_network{nullptr};
+    std::unique_ptr<Accumulator> m_accumulator;
 };
 
 }  // namespace breakthrough
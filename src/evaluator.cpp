@@ -0,0 +1,119 @@
+#include "evaluator.h"
+#include "movegen.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace breakthrough {
+
+namespace {
+
+thread_local std::mt19937 gen(std::random_device{}());
+thread_local MoveGen movegen;
+
+/**
+ * Play random moves until the end of the game, or until a position of
+ * the tablebase.
+ *
+ * Returns the discounted result for the player who moved into `start`.
+ */
+double rollout(const Board& start, const PatternTable* policy, const Tablebase* tablebase, double discount_rate) {
+    Board board = start;
+    int initial_ply = board.ply();
+    int remaining_plies = 0;
+    while (not board.is_terminal()) {
+        if (tablebase) {
+            if (auto exact = tablebase->probe(board)) {
+                remaining_plies = exact->plies;
+                break;
+            }
+        }
+        const std::vector<Move>& valid_moves = movegen.valid_moves(board);
+        if (valid_moves.empty()) {
+            break;
+        }
+        Move move;
+        if (policy) {
+            move = policy->sample(board, valid_moves, gen);
+        } else {
+            std::uniform_int_distribution<> dis(0, valid_moves.size() - 1);
+            move = valid_moves[dis(gen)];
+        }
+        board.play(move);
+    }
+    // With perfect play from a tablebase position, the game ends after its
+    // distance and the side to move then has lost, as after a rollout
+    int rollout_length = board.ply() - initial_ply + remaining_plies;
+    double discount = std::pow(discount_rate, rollout_length);
+    bool is_win = !(rollout_length & 1);
+    double reward = (2.0 * (double)is_win - 1) * discount;
+    return reward;
+}
+
+}  // namespace
+
+std::mt19937& evaluator_rng() {
+    return gen;
+}
+
+void RolloutEvaluator::evaluate(std::span<const Board> leaves, std::span<double> values) {
+    std::vector<Move> moves;
+    // The leaves may carry a network for another evaluator, which the
+    // rollouts do not need to keep up to date
+    Board child;
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        const Board& leaf = leaves[i];
+        moves = movegen.valid_moves(leaf);
+
+        double total_reward = 0.0;
+        for (const auto& move : moves) {
+            child.set_position(leaf);
+            child.play(move);
+            for (int r = 0; r < m_n_rollouts; ++r) {
+                total_reward += rollout(child, m_policy, m_tablebase, m_discount);
+            }
+        }
+        values[i] = total_reward / (m_n_rollouts * moves.size());
+    }
+}
+
+double StaticEvaluator::evaluate(const Board& board) {
+    double score = 0.0;
+    for (Square s = 0; s < 64; ++s) {
+        const Piece piece = board.at(s);
+        if (is_empty(piece)) {
+            continue;
+        }
+        // Pawns are worth more the closer they get to promotion
+        int progress = is_white(piece) ? s / 8 : 7 - s / 8;
+        double value = 1.0 + progress * progress / 16.0;
+        score += is_white(piece) ? value : -value;
+    }
+    const bool black_to_play = board.ply() & 1;
+    return std::tanh((black_to_play ? -score : score) / 8.0);
+}
+
+void StaticEvaluator::evaluate(std::span<const Board> leaves, std::span<double> values) {
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        values[i] = evaluate(leaves[i]);
+    }
+}
+
+void NnueEvaluator::evaluate(std::span<const Board> leaves, std::span<double> values) {
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        values[i] = m_network.evaluate(leaves[i]);
+    }
+}
+
+void BlendEvaluator::evaluate(std::span<const Board> leaves, std::span<double> values) {
+    thread_local std::vector<double> second_values;
+    second_values.resize(leaves.size());
+    m_first.evaluate(leaves, values);
+    m_second.evaluate(leaves, second_values);
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        values[i] = m_weight * values[i] + (1.0 - m_weight) * second_values[i];
+    }
+}
+
+}  // namespace breakthrough
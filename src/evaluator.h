@@ -0,0 +1,150 @@
+/**
+ * @file evaluator.h
+ *
+ * Leaf evaluation for the search.
+ *
+ * The search collects a batch of leaf positions before asking the
+ * evaluator for their values, so that an evaluator can amortise its
+ * cost over the whole batch.
+ */
+
+#ifndef EVALUATOR_H_
+#define EVALUATOR_H_
+
+#include "board.h"
+#include "nnue.h"
+#include "pattern.h"
+#include "tablebase.h"
+
+#include <random>
+#include <span>
+
+namespace breakthrough {
+
+/**
+ * The random generator used by evaluators on the calling thread.
+ *
+ * The search seeds it on each of its threads, so that a single-threaded
+ * search with a fixed seed is reproducible.
+ */
+std::mt19937& evaluator_rng();
+
+class Evaluator {
+public:
+    virtual ~Evaluator() = default;
+
+    /**
+     * Write in `values[i]` the expected result of `leaves[i]` for its
+     * side to move, between -1 (loss) and 1 (win).
+     *
+     * The leaves are never terminal and always have valid moves. This
+     * may be called from several search threads at once.
+     */
+    virtual void evaluate(std::span<const Board> leaves, std::span<double> values) = 0;
+
+    /**
+     * Set up the root of a search, which the leaves are copied from,
+     * e.g. to have them maintain what the evaluator needs incrementally.
+     */
+    virtual void prepare(Board& root) const { (void)root; }
+};
+
+/**
+ * Random playouts from each of the leaf's children, averaged.
+ */
+class RolloutEvaluator : public Evaluator {
+public:
+    /**
+     * The number of rollouts played from each child of the leaf, and the
+     * factor applied to their result for each move they lasted, usually
+     * those of the SearchConfig.
+     */
+    RolloutEvaluator(int n_rollouts, double discount)
+        : m_n_rollouts(n_rollouts), m_discount(discount) {}
+
+    /**
+     * Sample rollout moves from the given pattern weights instead of
+     * uniformly. The table must outlive the evaluator, pass nullptr to
+     * go back to uniform rollouts.
+     */
+    void set_policy(const PatternTable* policy) { m_policy = policy; }
+
+    /**
+     * End the rollouts with the exact result once they reach a position
+     * of the tablebase. The tablebase must outlive the evaluator, pass
+     * nullptr to play the rollouts to the end.
+     */
+    void set_tablebase(const Tablebase* tablebase) { m_tablebase = tablebase; }
+
+    void evaluate(std::span<const Board> leaves, std::span<double> values) override;
+
+private:
+    int m_n_rollouts;
+    double m_discount;
+    const PatternTable* m_policy{nullptr};
+    const Tablebase* m_tablebase{nullptr};
+};
+
+/**
+ * Hand-written evaluation from material and pawn advancement.
+ */
+class StaticEvaluator : public Evaluator {
+public:
+    void evaluate(std::span<const Board> leaves, std::span<double> values) override;
+
+    /**
+     * The evaluation of a single position.
+     */
+    static double evaluate(const Board& board);
+};
+
+/**
+ * Evaluation by a quantised network (see nnue.h).
+ */
+class NnueEvaluator : public Evaluator {
+public:
+    /**
+     * The network must outlive the evaluator.
+     */
+    explicit NnueEvaluator(const Network& network) : m_network(network) {}
+
+    void evaluate(std::span<const Board> leaves, std::span<double> values) override;
+
+    /**
+     * The leaves keep the network's first layer up to date as the
+     * search plays moves down to them.
+     */
+    void prepare(Board& root) const override { root.set_network(&m_network); }
+
+private:
+    const Network& m_network;
+};
+
+/**
+ * A weighted average of two evaluators, `weight` for the first one.
+ */
+class BlendEvaluator : public Evaluator {
+public:
+    BlendEvaluator(Evaluator& first, Evaluator& second, double weight)
+        : m_first(first), m_second(second), m_weight(weight) {}
+
+    void evaluate(std::span<const Board> leaves, std::span<double> values) override;
+
+    /**
+     * Boards maintain a single network: the first evaluator's if both
+     * have one.
+     */
+    void prepare(Board& root) const override {
+        m_second.prepare(root);
+        m_first.prepare(root);
+    }
+
+private:
+    Evaluator& m_first;
+    Evaluator& m_second;
+    double m_weight;
+};
+
+}  // namespace breakthrough
+
+#endif // EVALUATOR_H_
@@ -1,67 +1,32 @@
 #include "board.h"
+#include "evaluator.h"
 #include "mcts.h"
 #include "movegen.h"
+#include "nnue.h"
+#include "notation.h"
+#include "pattern.h"
+#include "shared.h"
+#include "tablebase.h"
 #include <iostream>
 #include <optional>
-#include <charconv>
+#include <memory>
 #include <random>
-#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 using namespace breakthrough;
 
-constexpr auto to_int = [](std::string_view sv) -> std::optional<int> {
-    int value{};
-    if (std::from_chars(sv.data(), sv.data() + sv.size(), value).ec == std::errc{}) {
-        return value;
-    }
-    return std::nullopt;
-};
-
-inline std::string print(Square s) {
-    const char files[8] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'};
-    std::stringstream result;
-    result << files[s % 8];
-    result << int(s / 8) + 1;
-    return result.str();
-}
-
-std::ostream& operator<<(std::ostream& out, const Move& move) {
-    return out << print(move.source) << print(move.target);
-}
-
-inline Square stos(std::string_view s) {
-    char file = s[0];
-    int ifile;
-    switch (file) {
-        case 'a': ifile = 0; break;
-        case 'b': ifile = 1; break;
-        case 'c': ifile = 2; break;
-        case 'd': ifile = 3; break;
-        case 'e': ifile = 4; break;
-        case 'f': ifile = 5; break;
-        case 'g': ifile = 6; break;
-        case 'h': ifile = 7; break;
-        default: throw std::runtime_error("Invalid file");
-    }
-    s.remove_prefix(1);
-    int irow = *to_int(s);
-
-    return ifile + (irow - 1) * 8;
-}
-
-inline Move get_move(std::string_view s) {
-    Move move;
-    move.source = stos(s.substr(0, 2));
-    move.target = stos(s.substr(2, 2));
-    return move;
-};
-
 std::optional<Move> turn_input() {
     static std::string buffer;
     Move move{-1, -1};
     std::getline(std::cin, buffer);
     if (buffer[0] != 'N') {
-        move = get_move(buffer);
+        auto parsed = parse_move(buffer);
+        if (!parsed) {
+            throw std::runtime_error("Invalid move " + buffer);
+        }
+        move = *parsed;
     }
     int n;
     std::cin >> n; std::cin.ignore();
@@ -71,24 +36,172 @@ std::optional<Move> turn_input() {
     return move.source == -1 ? std::nullopt : std::make_optional(move);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    SearchConfig config;
+    SearchBudget budget{90};
+
+    // Several processes, one per NUMA node, may search together: slot 0
+    // plays and the others help it (see shared.h)
+    std::string shared_name;
+    int n_processes = 1;
+    int slot = 0;
+    bool share_table = false;
+
+    // Optional rollout pattern weights and leaf evaluation network, the
+    // network's values blended with rollouts if --nnue-weight is below 1
+    std::string patterns_path;
+    std::string network_path;
+    std::string tablebase_path;
+    double nnue_weight = 1.0;
+
+    // A fixed seed and iteration budget make the games reproducible
+    for (int i = 1; i < argc; i += 2) {
+        std::string_view option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for option " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[i + 1];
+        if (option == "--seed") {
+            config.seed = std::stoull(value);
+        } else if (option == "--iterations") {
+            budget = SearchBudget{0, std::stol(value)};
+        } else if (option == "--exploration") {
+            config.exploration = std::stod(value);
+        } else if (option == "--rollouts") {
+            config.n_rollouts = std::stoi(value);
+        } else if (option == "--discount") {
+            config.discount = std::stod(value);
+        } else if (option == "--root-policy") {
+            const std::string_view policy = value;
+            if (policy == "halving") {
+                config.root_policy = RootPolicy::SequentialHalving;
+            } else if (policy == "ucb") {
+                config.root_policy = RootPolicy::Ucb;
+            } else {
+                std::cerr << "Unknown root policy " << policy << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (option == "--symmetry") {
+            config.symmetry = std::stoi(value) != 0;
+        } else if (option == "--shared") {
+            shared_name = value;
+        } else if (option == "--processes") {
+            n_processes = std::stoi(value);
+        } else if (option == "--slot") {
+            slot = std::stoi(value);
+        } else if (option == "--share-table") {
+            share_table = std::stoi(value) != 0;
+        } else if (option == "--patterns") {
+            patterns_path = value;
+        } else if (option == "--nnue") {
+            network_path = value;
+        } else if (option == "--nnue-weight") {
+            nnue_weight = std::stod(value);
+            if (nnue_weight < 0.0 || nnue_weight > 1.0) {
+                std::cerr << "The network weight must be between 0 and 1" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (option == "--tablebase") {
+            tablebase_path = value;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (!patterns_path.empty() && !network_path.empty() && nnue_weight == 1.0) {
+        std::cerr << "--patterns has no effect with --nnue unless --nnue-weight is below 1" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<SharedSearch> shared;
+    if (!shared_name.empty()) {
+        pin_to_numa_node(slot % numa_node_count());
+        shared = std::make_unique<SharedSearch>(shared_name, n_processes, slot, share_table ? config.table_mb : 0);
+        if (!*shared) {
+            std::cerr << "Failed to open shared search " << shared_name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<MCTS> search;
+    if (shared && shared->table_memory()) {
+        config.table_mb = shared->table_mb();
+        search = std::make_unique<MCTS>(config, shared->table_memory(), slot == 0);
+    } else {
+        search = std::make_unique<MCTS>(config);
+    }
+    MCTS& mcts = *search;
+
+    RolloutEvaluator rollouts(config.n_rollouts, config.discount);
+    PatternTable patterns;
+    if (!patterns_path.empty()) {
+        if (!patterns.load(patterns_path)) {
+            std::cerr << "Failed to load pattern weights from " << patterns_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        rollouts.set_policy(&patterns);
+    }
+    Network network;
+    if (!network_path.empty() && !network.load(network_path)) {
+        std::cerr << "Failed to load network from " << network_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    Tablebase tablebase;
+    if (!tablebase_path.empty()) {
+        if (tablebase.load(tablebase_path) == 0) {
+            std::cerr << "Failed to load tablebases from " << tablebase_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        mcts.set_tablebase(&tablebase);
+        rollouts.set_tablebase(&tablebase);
+    }
+
+    NnueEvaluator nnue(network);
+    BlendEvaluator blend(nnue, rollouts, nnue_weight);
+    if (!network_path.empty()) {
+        mcts.set_evaluator(nnue_weight < 1.0 ? static_cast<Evaluator*>(&blend) : &nnue);
+    } else {
+        mcts.set_evaluator(&rollouts);
+    }
+
+    // Helpers search the positions of the leader until it exits
+    if (shared && slot > 0) {
+        uint64_t generation = 0;
+        while (auto job = shared->next_job(generation)) {
+            generation = job->generation;
+            mcts.ponder(job->board, job->budget);
+            shared->publish(generation, mcts.root_stats(job->board));
+        }
+        return 0;
+    }
+
     Board board;
-    MCTS mcts;
 
     Move move;
     std::string buffer;
 
-    while (true) {
+    // Stop at the end of the input, so that a shared segment is removed
+    while (std::cin.peek() != EOF) {
         auto move_in = turn_input();
         if (move_in) {
             board.play(*move_in);
         }
 
-        mcts.ponder(board, 90);
-        move = mcts.choose_best(board);
+        if (shared) {
+            uint64_t generation = shared->start(board, budget);
+            mcts.ponder(board, budget);
+            shared->publish(generation, mcts.root_stats(board));
+            // The helpers started with us and should be about done
+            shared->wait(budget.ms > 0 ? budget.ms : 1000);
+            move = shared->choose_best(board);
+        } else {
+            mcts.ponder(board, budget);
+            move = mcts.choose_best(board);
+        }
         board.play(move);
 
-        std::cout << move << std::endl;
+        std::cout << to_string(move) << std::endl;
     }
 
     return 0;
@@ -0,0 +1,98 @@
+/**
+ * Self-play data generator.
+ *
+ * Plays games between two MCTS instances on every core and appends each
+ * position, with the root visit distribution of the search and the final
+ * result, to a binary record file (see record.h).
+ *
+ * Usage: Breakthrough_SELFPLAY <output> [games] [ms_per_move] [threads]
+ */
+
+#include "board.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "record.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace breakthrough;
+
+namespace {
+
+/**
+ * Play one game and return its positions, with results filled in.
+ */
+std::vector<PositionRecord> play_game(int ms_per_move) {
+    std::vector<PositionRecord> records;
+    Board board;
+    MCTS players[2];
+    MoveGen movegen;
+
+    while (!board.is_terminal() && !movegen.valid_moves(board).empty()) {
+        MCTS& mcts = players[board.ply() & 1];
+        mcts.ponder(board, ms_per_move);
+
+        // Root stats are in MoveGen order
+        std::vector<int> move_visits;
+        for (const auto& stats : mcts.root_stats(board)) {
+            move_visits.push_back(stats.visits);
+        }
+        records.push_back(make_record(board, move_visits));
+
+        board.play(mcts.choose_best(board));
+    }
+
+    // The side to move at the end has lost
+    const int loser_parity = board.ply() & 1;
+    for (auto& record : records) {
+        record.result = (record.ply & 1) == loser_parity ? -1 : 1;
+    }
+    return records;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output> [games] [ms_per_move] [threads]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string output_path = argv[1];
+    const int n_games = argc > 2 ? std::stoi(argv[2]) : 100;
+    const int ms_per_move = argc > 3 ? std::stoi(argv[3]) : 90;
+    const int n_threads = argc > 4 ? std::stoi(argv[4])
+                                   : std::max(1u, std::thread::hardware_concurrency());
+
+    RecordWriter writer(output_path);
+    if (!writer) {
+        std::cerr << "Failed to open " << output_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<int> next_game{0};
+    std::atomic<long> n_positions{0};
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < n_threads; ++t) {
+        workers.emplace_back([&]() {
+            while (next_game++ < n_games) {
+                auto records = play_game(ms_per_move);
+                writer.write(records);
+                n_positions += records.size();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::cout << "Wrote " << n_positions << " positions from " << n_games
+              << " games to " << output_path << std::endl;
+
+    return 0;
+}
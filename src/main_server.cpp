@@ -0,0 +1,131 @@
+/**
+ * Engine server hosting many games at once (see server.h for the protocol).
+ *
+ * Reads commands on stdin and replies on stdout, or with --socket serves
+ * every client connecting to a local unix socket. All the games share
+ * one pool of search threads, and each game has its own node table of
+ * --table-mb megabytes.
+ *
+ * Usage: Breakthrough_SERVER [--threads <n>] [--table-mb <n>] [--socket <path>]
+ */
+
+#include "server.h"
+#include "thread_pool.h"
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace breakthrough;
+
+namespace {
+
+void serve_stdio(ThreadPool& pool, const SearchConfig& config) {
+    std::mutex mutex;
+    Server server(pool, [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << line << std::endl;
+    }, config);
+
+    std::string line;
+    while (std::getline(std::cin, line) && line != "quit") {
+        server.handle(line);
+    }
+}
+
+void serve_client(ThreadPool& pool, const SearchConfig& config, int fd) {
+    std::mutex mutex;
+    Server server(pool, [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string data = line + '\n';
+        for (std::size_t written = 0; written < data.size();) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n <= 0) {
+                return;
+            }
+            written += n;
+        }
+    }, config);
+
+    std::string buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.append(chunk, n);
+        std::size_t end;
+        while ((end = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (line == "quit") {
+                server.wait();
+                ::close(fd);
+                return;
+            }
+            server.handle(line);
+        }
+    }
+    server.wait();
+    ::close(fd);
+}
+
+int serve_socket(ThreadPool& pool, const SearchConfig& config, const std::string& path) {
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Failed to create socket " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    path.copy(address.sun_path, path.size());
+    ::unlink(path.c_str());
+
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 64) != 0) {
+        std::cerr << "Failed to listen on " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        std::thread(serve_client, std::ref(pool), std::cref(config), client).detach();
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int n_threads = 0;
+    SearchConfig config;
+    std::string socket_path;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view option = argv[i];
+        if (option == "--threads") {
+            n_threads = std::stoi(argv[i + 1]);
+        } else if (option == "--table-mb") {
+            config.table_mb = std::stoul(argv[i + 1]);
+        } else if (option == "--socket") {
+            socket_path = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool pool(n_threads);
+
+    if (!socket_path.empty()) {
+        return serve_socket(pool, config, socket_path);
+    }
+    serve_stdio(pool, config);
+
+    return 0;
+}
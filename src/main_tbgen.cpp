@@ -0,0 +1,52 @@
+/**
+ * Endgame tablebase generator.
+ *
+ * Solves every position with at most the given number of pawns on every
+ * core, and writes one table per material to the output directory (see
+ * tablebase.h).
+ *
+ * Usage: Breakthrough_TBGEN <directory> [max_pieces] [threads]
+ */
+
+#include "tablebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace breakthrough;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <directory> [max_pieces] [threads]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string directory = argv[1];
+    const int max_pieces = argc > 2 ? std::stoi(argv[2]) : 4;
+    const int n_threads = argc > 3 ? std::stoi(argv[3])
+                                   : std::max(1u, std::thread::hardware_concurrency());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create " << directory << ": " << error.message() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    Tablebase tablebase;
+    tablebase.generate(max_pieces, n_threads);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time);
+
+    if (!tablebase.save(directory)) {
+        std::cerr << "Failed to write the tables to " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Solved every position with up to " << tablebase.max_pieces() << " pawns in "
+              << elapsed.count() << " s, written to " << directory << std::endl;
+
+    return 0;
+}
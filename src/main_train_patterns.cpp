@@ -0,0 +1,195 @@
+/**
+ * Offline trainer for the rollout pattern weights.
+ *
+ * Reads recorded games, one game per line given as a sequence of moves
+ * in algebraic notation ("d2e3 c7c6 ..."), and fits the weights of a
+ * softmax policy over the pattern codes of the valid moves so as to
+ * maximize the likelihood of the moves that were played.
+ *
+ * With --records, the input is a self-play record file (see record.h)
+ * and the policy is fitted to the root visit distributions instead.
+ *
+ * Usage: Breakthrough_TRAIN_PATTERNS [--records] <input> <output> [epochs] [learning_rate]
+ */
+
+#include "board.h"
+#include "movegen.h"
+#include "notation.h"
+#include "pattern.h"
+#include "record.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace breakthrough;
+
+namespace {
+
+/**
+ * A position from the games: the pattern codes of all the valid moves
+ * and the target probability of each of them.
+ */
+struct Sample {
+    std::vector<int> codes;
+    std::vector<double> targets;
+};
+
+std::vector<Sample> read_games(std::istream& in) {
+    std::vector<Sample> samples;
+    MoveGen movegen;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(in, line)) {
+        ++line_number;
+        std::istringstream moves(line);
+        Board board;
+        std::string token;
+
+        while (moves >> token) {
+            auto move = parse_move(token);
+            const auto& valid_moves = movegen.valid_moves(board);
+            auto it = std::find_if(valid_moves.begin(), valid_moves.end(), [&](const Move& m) {
+                return move && m.source == move->source && m.target == move->target;
+            });
+            if (it == valid_moves.end()) {
+                std::cerr << "line " << line_number << ": invalid move " << token
+                          << ", skipping the rest of the game" << std::endl;
+                break;
+            }
+
+            Sample sample;
+            for (const auto& m : valid_moves) {
+                sample.codes.push_back(pattern_code(board, m));
+            }
+            sample.targets.assign(valid_moves.size(), 0.0);
+            sample.targets[it - valid_moves.begin()] = 1.0;
+            samples.push_back(std::move(sample));
+
+            board.play(*move);
+        }
+    }
+    return samples;
+}
+
+std::vector<Sample> read_records(const RecordFile& records) {
+    std::vector<Sample> samples;
+    MoveGen movegen;
+
+    for (const auto& record : records) {
+        if (record.total_visits == 0) {
+            continue;
+        }
+        Board board = record.board();
+        const auto& valid_moves = movegen.valid_moves(board);
+        if (valid_moves.size() != record.n_moves) {
+            continue;
+        }
+
+        Sample sample;
+        for (std::size_t i = 0; i < valid_moves.size(); ++i) {
+            sample.codes.push_back(pattern_code(board, valid_moves[i]));
+            sample.targets.push_back(record.policy(i));
+        }
+        samples.push_back(std::move(sample));
+    }
+    return samples;
+}
+
+/**
+ * One pass of stochastic gradient ascent on the log-likelihood of the
+ * targets (the negated cross-entropy).
+ *
+ * Returns the average log-likelihood of the samples before their update.
+ */
+double train_epoch(std::vector<Sample>& samples, std::vector<double>& theta, double learning_rate, std::mt19937& gen) {
+    std::shuffle(samples.begin(), samples.end(), gen);
+
+    std::vector<double> probs;
+    double log_likelihood = 0.0;
+
+    for (const auto& sample : samples) {
+        probs.resize(sample.codes.size());
+        double max_theta = -INFINITY;
+        for (auto code : sample.codes) {
+            max_theta = std::max(max_theta, theta[code]);
+        }
+        double total = 0.0;
+        for (std::size_t i = 0; i < sample.codes.size(); ++i) {
+            probs[i] = std::exp(theta[sample.codes[i]] - max_theta);
+            total += probs[i];
+        }
+        for (auto& p : probs) {
+            p /= total;
+        }
+        for (std::size_t i = 0; i < sample.codes.size(); ++i) {
+            if (sample.targets[i] > 0.0) {
+                log_likelihood += sample.targets[i] * std::log(probs[i]);
+            }
+            theta[sample.codes[i]] += learning_rate * (sample.targets[i] - probs[i]);
+        }
+    }
+
+    return log_likelihood / std::max<std::size_t>(samples.size(), 1);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const bool from_records = argc > 1 && std::string(argv[1]) == "--records";
+    if (from_records) {
+        --argc;
+        ++argv;
+    }
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " [--records] <input> <output> [epochs] [learning_rate]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string input_path = argv[1];
+    const std::string output_path = argv[2];
+    const int epochs = argc > 3 ? std::stoi(argv[3]) : 10;
+    const double learning_rate = argc > 4 ? std::stod(argv[4]) : 0.1;
+
+    std::vector<Sample> samples;
+    if (from_records) {
+        RecordFile records(input_path);
+        if (!records) {
+            std::cerr << "Failed to open " << input_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        samples = read_records(records);
+    } else {
+        std::ifstream games(input_path);
+        if (!games) {
+            std::cerr << "Failed to open " << input_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        samples = read_games(games);
+    }
+    std::cout << "Read " << samples.size() << " positions" << std::endl;
+
+    std::vector<double> theta(n_patterns, 0.0);
+    std::mt19937 gen(0);
+
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        double log_likelihood = train_epoch(samples, theta, learning_rate, gen);
+        std::cout << "epoch " << epoch + 1 << ": log-likelihood " << log_likelihood << std::endl;
+    }
+
+    PatternTable table;
+    for (int code = 0; code < n_patterns; ++code) {
+        table.set_weight(code, static_cast<float>(std::exp(std::clamp(theta[code], -20.0, 20.0))));
+    }
+    if (!table.save(output_path)) {
+        std::cerr << "Failed to write " << output_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
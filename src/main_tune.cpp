@@ -0,0 +1,174 @@
+/**
+ * SPSA tuner for the search constants.
+ *
+ * At each iteration, every parameter is perturbed by a random +/- step
+ * and two configurations, one perturbed each way, play pairs of games
+ * against each other on every core at a fixed time per move. The match
+ * score estimates the gradient along the perturbation and the parameters
+ * move towards the winner, with gains that decrease over the iterations
+ * (Spall's simultaneous perturbation stochastic approximation).
+ *
+ * The best constants depend on how many iterations the engine runs in
+ * the time it is given, so they should be retuned at the time control
+ * and on the hardware they are meant for.
+ *
+ * Usage: Breakthrough_TUNE [iterations] [game_pairs] [ms_per_move] [threads]
+ */
+
+#include "board.h"
+#include "mcts.h"
+#include "movegen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace breakthrough;
+
+namespace {
+
+/**
+ * A tuned constant, perturbed in units of its step.
+ */
+struct Parameter {
+    const char* name;
+    double value;
+    double min;
+    double max;
+    double step;
+};
+
+SearchConfig make_config(const std::vector<Parameter>& parameters) {
+    SearchConfig config;
+    config.exploration = parameters[0].value;
+    config.n_rollouts = std::max(1, static_cast<int>(std::lround(parameters[1].value)));
+    config.discount = parameters[2].value;
+    return config;
+}
+
+/**
+ * Play one game and return 1 if white won, 0 otherwise.
+ */
+int play_game(const SearchConfig& white, const SearchConfig& black, int ms_per_move) {
+    Board board;
+    MCTS white_player(white);
+    MCTS black_player(black);
+    MoveGen movegen;
+
+    while (!board.is_terminal() && !movegen.valid_moves(board).empty()) {
+        MCTS& mcts = board.ply() & 1 ? black_player : white_player;
+        mcts.ponder(board, ms_per_move);
+        board.play(mcts.choose_best(board));
+    }
+
+    // The side to move at the end has lost
+    return board.ply() & 1;
+}
+
+/**
+ * Play pairs of games, each configuration having white once, and return
+ * the score of the first one between -1 and 1.
+ */
+double play_match(const SearchConfig& first, const SearchConfig& second,
+                  int n_pairs, int ms_per_move, int n_threads) {
+    std::atomic<int> next_game{0};
+    std::atomic<int> first_wins{0};
+
+    const int n_games = 2 * n_pairs;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < n_threads; ++t) {
+        workers.emplace_back([&]() {
+            int game;
+            while ((game = next_game++) < n_games) {
+                if (game & 1) {
+                    first_wins += 1 - play_game(second, first, ms_per_move);
+                } else {
+                    first_wins += play_game(first, second, ms_per_move);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return 2.0 * first_wins / n_games - 1.0;
+}
+
+void print(const std::vector<Parameter>& parameters) {
+    for (const auto& parameter : parameters) {
+        std::cout << ' ' << parameter.name << '=' << parameter.value;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int n_iterations = argc > 1 ? std::stoi(argv[1]) : 100;
+    const int n_pairs = argc > 2 ? std::stoi(argv[2]) : 8;
+    const int ms_per_move = argc > 3 ? std::stoi(argv[3]) : 50;
+    const int n_threads = argc > 4 ? std::stoi(argv[4])
+                                   : std::max(1u, std::thread::hardware_concurrency());
+    if (n_iterations < 1 || n_pairs < 1 || ms_per_move < 1 || n_threads < 1) {
+        std::cerr << "Usage: " << argv[0] << " [iterations] [game_pairs] [ms_per_move] [threads]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const SearchConfig defaults;
+    std::vector<Parameter> parameters = {
+        {"exploration", defaults.exploration, 0.05, 4.0, 0.3},
+        {"rollouts", double(defaults.n_rollouts), 1.0, 32.0, 2.0},
+        {"discount", defaults.discount, 0.9, 1.0, 0.01},
+    };
+
+    // Usual SPSA gain sequences, with the stability constant at a tenth
+    // of the run and the perturbations in units of each parameter's step
+    constexpr double alpha = 0.602;
+    constexpr double gamma = 0.101;
+    const double stability = n_iterations / 10.0;
+    const double a = std::pow(1.0 + stability, alpha);
+
+    std::mt19937 gen(std::random_device{}());
+    std::bernoulli_distribution coin;
+
+    for (int k = 0; k < n_iterations; ++k) {
+        const double a_k = a / std::pow(k + 1 + stability, alpha);
+        const double c_k = 1.0 / std::pow(k + 1, gamma);
+
+        std::vector<double> delta(parameters.size());
+        std::vector<Parameter> plus = parameters;
+        std::vector<Parameter> minus = parameters;
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            delta[i] = coin(gen) ? 1.0 : -1.0;
+            const double shift = c_k * delta[i] * parameters[i].step;
+            plus[i].value = std::clamp(parameters[i].value + shift, parameters[i].min, parameters[i].max);
+            minus[i].value = std::clamp(parameters[i].value - shift, parameters[i].min, parameters[i].max);
+        }
+
+        const double score = play_match(make_config(plus), make_config(minus),
+                                        n_pairs, ms_per_move, n_threads);
+
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            const double gradient = score / (2.0 * c_k * delta[i]);
+            parameters[i].value = std::clamp(parameters[i].value + a_k * gradient * parameters[i].step,
+                                             parameters[i].min, parameters[i].max);
+        }
+
+        std::cout << "iteration " << k + 1 << " score " << std::showpos << std::fixed
+                  << std::setprecision(3) << score << std::noshowpos << std::setprecision(4);
+        print(parameters);
+        std::cout << std::endl;
+    }
+
+    const SearchConfig tuned = make_config(parameters);
+    std::cout << "--exploration " << tuned.exploration
+              << " --rollouts " << tuned.n_rollouts
+              << " --discount " << tuned.discount << std::endl;
+
+    return 0;
+}
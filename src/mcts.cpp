@@ -1,13 +1,21 @@
 #include "mcts.h"
 #include "movegen.h"
+#include "perf.h"
+#include "ucb.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <limits>
-#include <unordered_map>
-#include <random>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
 
 #include <iostream>
 
@@ -15,153 +23,422 @@ namespace breakthrough {
 
 namespace {
 
-static std::random_device rd;
-static std::mt19937 gen(rd());
 thread_local MoveGen movegen;
-thread_local std::unordered_map<uint64_t, Node>* stats;
 
-inline double ucb1(const Node& node, double C) {
-    if (node.visits == 0) {
-        return std::numeric_limits<double>::max();
-    }
-    double avrg = node.reward / node.visits;
-    double expl = C * std::sqrt(std::log(stats->at(node.parent).visits) / node.visits);
-    return avrg + expl;
+/**
+ * A selected leaf waiting for its evaluation, with the hashes of the
+ * positions from the root down to it.
+ */
+struct PendingLeaf {
+    std::vector<uint64_t> path;
+};
+
+/**
+ * What guides the descent from the root.
+ */
+struct Descent {
+    double exploration;
+    const Tablebase* tablebase;
+    bool symmetry;
+
+    /**
+     * If not empty, the moves played at the root in turn instead of the
+     * one selected by UCB1, counting in `next_root_move`.
+     */
+    std::span<const Move> root_moves;
+    std::atomic<unsigned long>* next_root_move;
+};
 
+/**
+ * The key of a position in the node table. With symmetry, a position and
+ * its mirror image share the same key, hence the same statistics.
+ */
+uint64_t node_key(const Board& board, bool symmetry) {
+    return symmetry ? board.canonical_hash() : board.hash();
 }
 
-inline bool is_leaf(const Node& node) {
-    return node.children.empty();
+uint64_t node_key_after(const Board& board, Move move, bool symmetry) {
+    return symmetry ? board.canonical_hash_after(move) : board.hash_after(move);
 }
 
-Node& select_ucb(const Node& node, double C = 1.4142135623730951) {
-    auto it = std::max_element(
-        node.children.begin(), node.children.end(),
-        [C](const auto& a, const auto& b) {
-            return ucb1(stats->at(a), C) < ucb1(stats->at(b), C);
-        });
-    return stats->at(*it);
-}
-
-Node& expand(Node& node) {
-    assert(node.children.empty() && "Trying to expand already expanded node");
-    Node* parent = &node;
-    auto parent_board = node.state;
-    auto parent_hash = parent_board.hash();
-    const auto& valid_moves = movegen.valid_moves(node.state);
-
-    // Reserve enough space so that `parent` pointer doesn't get invalidated
-    auto size_before_rehashing = stats->max_load_factor() * stats->bucket_count();
-    if (stats->size() + valid_moves.size() > size_before_rehashing) {
-        stats->reserve(stats->size() + valid_moves.size());
-        parent = &stats->at(parent_hash);
-    }
-    for (const auto& move : valid_moves) {
-        auto board = parent_board;
-        board.play(move);
-        auto child_hash = board.hash();
-        parent->children.push_back(child_hash);
-        auto [it, inserted] = stats->try_emplace(child_hash);
-        if (inserted) {
-            it->second.state = board;
-        }
-        it->second.move = move;
-        it->second.parent = parent_hash;
+/**
+ * log(n) for the small visit counts most nodes have.
+ */
+constexpr int log_table_size = 4096;
+
+const auto log_table = [] {
+    std::array<float, log_table_size> table{};
+    for (int n = 1; n < log_table_size; ++n) {
+        table[n] = std::log(float(n));
+    }
+    return table;
+}();
+
+inline float log_visits(int32_t visits) {
+    return visits < log_table_size ? log_table[visits] : std::log(float(visits));
+}
+
+/**
+ * The move to the child with the best UCB1 value, or {-1, -1} if the
+ * position has no valid moves.
+ */
+Move select_ucb(const NodeTable& table, const Board& board, NodeStats parent, double C, bool symmetry) {
+    const auto& valid_moves = movegen.valid_moves(board);
+    const int n_children = valid_moves.size();
+    if (n_children == 0) {
+        return Move{-1, -1};
+    }
+    assert(n_children <= max_moves && "boards have at most max_pawns pawns per side");
+
+    // Start loading every child's bucket before reading any of them
+    uint64_t hashes[max_moves];
+    for (int i = 0; i < n_children; ++i) {
+        hashes[i] = node_key_after(board, valid_moves[i], symmetry);
+        table.prefetch(hashes[i]);
     }
 
-    return *parent;
+    ChildStats children;
+    for (int i = 0; i < n_children; ++i) {
+        NodeStats child = table.probe(hashes[i]);
+        children.visits[i] = static_cast<float>(child.visits);
+        children.rewards[i] = child.reward;
+    }
+    for (int i = n_children; i % 8 != 0; ++i) {
+        children.visits[i] = 1.0f;
+        children.rewards[i] = -std::numeric_limits<float>::infinity();
+    }
+
+    return valid_moves[argmax_ucb1(children, n_children, log_visits(parent.visits), static_cast<float>(C))];
 }
 
-double rollout(const Node& node) {
-    Board board = node.state;
-    int initial_ply = board.ply();
-    while (not board.is_terminal()) {
-        const std::vector<Move>& valid_moves = movegen.valid_moves(board);
-        std::uniform_int_distribution<> dis(0, valid_moves.size() - 1);
-        Move move = valid_moves[dis(gen)];
-        board.play(move);
+/**
+ * Count a loss for every node of the path while its leaf is pending, so
+ * that the next selections, from this batch or other threads, avoid it.
+ */
+void add_virtual_loss(NodeTable& table, const std::vector<uint64_t>& path) {
+    for (auto hash : path) {
+        table.update(hash, [](NodeStats stats) {
+            ++stats.visits;
+            stats.reward -= 1.0f;
+            return stats;
+        });
     }
-    int rollout_length = board.ply() - initial_ply;
-    double discount = std::pow(0.99, rollout_length);
-    bool is_win = !(rollout_length & 1);
-    double reward = (2.0 * (double)is_win - 1) * discount;
-    return reward;
 }
 
-void backpropagate(Node& node, double reward) {
-    for (Node* pnode = &node; pnode->parent != 0; pnode = &stats->at(pnode->parent)) {
-        pnode->reward += reward;
-        ++pnode->visits;
+/**
+ * Add the reward, for the player who moved into the leaf, along the path
+ * and take back the virtual loss.
+ *
+ * Nodes replaced in the table while the leaf was pending are skipped:
+ * inserting them again would count a reward without its visit.
+ */
+void backpropagate(NodeTable& table, const std::vector<uint64_t>& path, double reward) {
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        table.update_if_present(*it, [reward](NodeStats stats) {
+            stats.reward += static_cast<float>(reward + 1.0);
+            return stats;
+        });
         reward *= -1.0;
     }
 }
 
-void step(Node& root) {
-    Node* node = &root;
-    bool is_mine = true;
-    while(not is_leaf(*node)) {
-        node = &select_ucb(*node);
-        is_mine = !is_mine;
+/**
+ * Descend from the root to a position that has not been visited yet and
+ * either backpropagate its exact value if the game is over there or it is
+ * in the tablebase, or queue it for evaluation.
+ *
+ * Returns the number of positions visited.
+ */
+int select_leaf(NodeTable& table, const Board& root, const Descent& descent,
+                std::vector<PendingLeaf>& pending, std::vector<Board>& leaves) {
+    PendingLeaf leaf;
+    Board board = root;
+    leaf.path.push_back(node_key(board, descent.symmetry));
+
+    bool has_moves = true;
+    bool game_over;
+    std::optional<TablebaseValue> exact;
+    {
+        PERF_SCOPE(perf::Phase::Select);
+        NodeStats stats = table.probe(leaf.path.back());
+        while (stats.visits > 0 && not board.is_terminal()) {
+            Move move = leaf.path.size() == 1 && !descent.root_moves.empty()
+                ? descent.root_moves[descent.next_root_move->fetch_add(1) % descent.root_moves.size()]
+                : select_ucb(table, board, stats, descent.exploration, descent.symmetry);
+            if (move.source == -1) {
+                has_moves = false;
+                break;
+            }
+            board.play(move);
+            leaf.path.push_back(node_key(board, descent.symmetry));
+            stats = table.probe(leaf.path.back());
+
+            // Below the root, solved positions are leaves with an exact value
+            if (descent.tablebase && (exact = descent.tablebase->probe(board))) {
+                break;
+            }
+        }
+        game_over = exact || !has_moves || board.is_terminal() || movegen.valid_moves(board).empty();
     }
-    node = &expand(*node);
 
-    if (node->state.is_terminal()) {
-        double reward = 2.0 * (double)(is_mine) - 1;
-        backpropagate(*node, reward);
+    {
+        PERF_SCOPE(perf::Phase::VirtualLoss);
+        add_virtual_loss(table, leaf.path);
     }
 
-    int n_rollouts = 5;
-    double total_reward = 0.0;
-    for (const auto& child_hash : node->children) {
-        auto& child_node = stats->at(child_hash);
-        for (auto i = 0; i < n_rollouts; ++i) {
-            double reward = rollout(child_node);
-            total_reward -= reward;
-        }
+    // The player who moved into a position without moves has won, and
+    // tablebase values are for the side to move
+    if (game_over) {
+        PERF_SCOPE(perf::Phase::Backpropagate);
+        backpropagate(table, leaf.path, exact && exact->win ? -1.0 : 1.0);
+        return leaf.path.size();
     }
 
-    double reward = total_reward / (n_rollouts * node->children.size());
-    backpropagate(*node, reward);
+    int n_nodes = leaf.path.size();
+    leaves.push_back(board);
+    pending.push_back(std::move(leaf));
+    return n_nodes;
+}
+
+/**
+ * Select and evaluate a batch of leaves.
+ *
+ * Returns the number of positions visited.
+ */
+int step(NodeTable& table, const Board& root, Evaluator& evaluator, int batch_size, const Descent& descent) {
+    thread_local std::vector<PendingLeaf> pending;
+    thread_local std::vector<Board> leaves;
+    thread_local std::vector<double> values;
+    pending.clear();
+    leaves.clear();
+
+    int n_nodes = 0;
+    for (int i = 0; i < batch_size; ++i) {
+        n_nodes += select_leaf(table, root, descent, pending, leaves);
+    }
+    if (leaves.empty()) {
+        return n_nodes;
+    }
+
+    values.resize(leaves.size());
+    {
+        PERF_SCOPE(perf::Phase::Evaluate);
+        evaluator.evaluate(leaves, values);
+    }
+
+    // Values are for the side to move, rewards for the player who moved
+    PERF_SCOPE(perf::Phase::Backpropagate);
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        backpropagate(table, pending[i].path, -values[i]);
+    }
+    return n_nodes;
 }
 
 } // namespace
 
-void MCTS::ponder(const Board& board, int ms) {
-    stats = &m_stats;
+MCTS::MCTS(SearchConfig config)
+    : m_config(config),
+      m_table(config.table_mb, config.threads > 1 ? NumaPlacement::Interleaved : NumaPlacement::Local),
+      m_rollouts(config.n_rollouts, config.discount),
+      m_evaluator(&m_rollouts),
+      m_rng(config.seed ? config.seed : std::random_device{}())
+{
+}
+
+MCTS::MCTS(SearchConfig config, void* table_memory, bool initialize_table)
+    : m_config(config),
+      m_table(table_memory, NodeTable::bytes_for(config.table_mb), initialize_table),
+      m_rollouts(config.n_rollouts, config.discount),
+      m_evaluator(&m_rollouts),
+      m_rng(config.seed ? config.seed : std::random_device{}())
+{
+}
+
+SearchInfo MCTS::ponder(const Board& board, int ms) {
+    return ponder(board, SearchBudget{ms});
+}
 
-    Node& root = m_stats[board.hash()];
-    root.state = board;
-    root.parent = 0;
-    root.move = {-1, -1};
+SearchInfo MCTS::ponder(const Board& board, SearchBudget budget) {
+    assert((budget.ms > 0 || budget.iterations > 0 || budget.nodes > 0) && "search budget is unlimited");
+
+    m_root_choice.reset();
+    SearchInfo info = m_config.root_policy == RootPolicy::SequentialHalving ? ponder_halving(board, budget)
+                                                                            : run(board, budget, {});
+#ifdef BREAKTHROUGH_PERF
+    if (m_perf_output) {
+        take_perf_report().print(*m_perf_output);
+    }
+#endif
+    return info;
+}
+
+perf::Report MCTS::take_perf_report() {
+    return std::exchange(m_perf_report, perf::Report{});
+}
+
+SearchInfo MCTS::ponder_halving(const Board& board, SearchBudget budget) {
+    std::vector<Move> candidates = movegen.valid_moves(board);
+    if (candidates.size() < 2) {
+        return run(board, budget, {});
+    }
+
+    // Rank the moves by their average reward, unvisited ones last
+    auto rank = [&]() {
+        auto value = [&](Move move) {
+            NodeStats child = m_table.probe(node_key_after(board, move, m_config.symmetry));
+            return child.visits ? double(child.reward) / child.visits : -std::numeric_limits<double>::max();
+        };
+        std::stable_sort(candidates.begin(), candidates.end(), [&](Move a, Move b) {
+            return value(a) > value(b);
+        });
+    };
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const int n_rounds = std::bit_width(candidates.size() - 1);
+    SearchInfo info;
+    for (int round = 0; round < n_rounds; ++round) {
+        // Split what is left of the budget evenly over the remaining rounds
+        const int rounds_left = n_rounds - round;
+        SearchBudget share;
+        if (budget.ms > 0) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start_time).count();
+            if (elapsed >= budget.ms) {
+                break;
+            }
+            share.ms = std::max<int>(1, (budget.ms - elapsed) / rounds_left);
+        }
+        if (budget.iterations > 0) {
+            if (info.iterations >= budget.iterations) {
+                break;
+            }
+            share.iterations = std::max<long>(1, (budget.iterations - info.iterations) / rounds_left);
+        }
+        if (budget.nodes > 0) {
+            if (info.nodes >= budget.nodes) {
+                break;
+            }
+            share.nodes = std::max<long>(1, (budget.nodes - info.nodes) / rounds_left);
+        }
+
+        SearchInfo round_info = run(board, share, candidates);
+        info.iterations += round_info.iterations;
+        info.nodes += round_info.nodes;
+
+        rank();
+        candidates.resize((candidates.size() + 1) / 2);
+    }
+
+    rank();
+    m_root_choice = RootChoice{board.hash(), board.ply(), candidates.front()};
+    info.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    return info;
+}
+
+SearchInfo MCTS::run(const Board& board, SearchBudget budget, std::span<const Move> root_moves) {
+    std::atomic<long> iterations{0};
+    std::atomic<long> nodes{0};
+    std::atomic<unsigned long> next_root_move{0};
+    const Descent descent{m_config.exploration, m_tablebase, m_config.symmetry, root_moves, &next_root_move};
+    Board root = board;
+    m_evaluator->prepare(root);
+#ifdef BREAKTHROUGH_PERF
+    std::mutex report_mutex;
+#endif
 
     auto start_time = std::chrono::steady_clock::now();
-    while (true) {
-        auto current_time =
-            std::chrono::steady_clock::now();
-        auto elapsed_time =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                current_time - start_time);
-        if (elapsed_time.count() >= ms) {
-            break;
+    auto search = [&](uint64_t seed) {
+        evaluator_rng().seed(static_cast<std::mt19937::result_type>(seed));
+        while (true) {
+            auto current_time =
+                std::chrono::steady_clock::now();
+            auto elapsed_time =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    current_time - start_time);
+            if (budget.ms > 0 && elapsed_time.count() >= budget.ms) {
+                break;
+            }
+            if (budget.nodes > 0 && nodes >= budget.nodes) {
+                break;
+            }
+
+            // Claim the iterations of the batch, the last one may be smaller
+            long batch_size = m_config.batch_size;
+            long claimed = iterations.fetch_add(batch_size);
+            if (budget.iterations > 0) {
+                if (claimed >= budget.iterations) {
+                    break;
+                }
+                batch_size = std::min(batch_size, budget.iterations - claimed);
+            }
+            nodes += step(m_table, root, *m_evaluator, batch_size, descent);
         }
-        step(root);
+#ifdef BREAKTHROUGH_PERF
+        std::lock_guard lock(report_mutex);
+        perf::collect(m_perf_report);
+#endif
+    };
+
+    std::vector<uint64_t> seeds(std::max(m_config.threads, 1));
+    for (auto& seed : seeds) {
+        seed = m_rng();
     }
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < m_config.threads; ++i) {
+        helpers.emplace_back(search, seeds[i]);
+    }
+    search(seeds[0]);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    SearchInfo info;
+    info.iterations = budget.iterations > 0 ? std::min(iterations.load(), budget.iterations) : iterations.load();
+    info.nodes = nodes;
+    info.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    return info;
 }
 
 Move MCTS::choose_best(const Board& board) {
-    auto& root = m_stats[board.hash()];
-    assert(not root.children.empty() && "cannot choose best on leaf node");
+    if (m_root_choice && m_root_choice->ply == board.ply()) {
+        if (m_root_choice->hash == board.hash()) {
+            return m_root_choice->move;
+        }
+        // The search was of the mirror image of this position
+        if (m_config.symmetry && m_root_choice->hash == board.mirror_hash()) {
+            return mirror(m_root_choice->move);
+        }
+    }
 
-    auto child_hash = *std::max_element(root.children.begin(), root.children.end(),
-                     [&](const auto& a, const auto& b) {
-                         return m_stats[a].visits < m_stats[b].visits;
+    auto stats = root_stats(board);
+    assert(not stats.empty() && "cannot choose best without valid moves");
+
+    auto best = std::max_element(stats.begin(), stats.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.visits < b.visits;
                      });
-    const auto& child = m_stats[child_hash];
-    return child.move;
+    return best->move;
+}
+
+std::vector<RootStats> MCTS::root_stats(const Board& board) const {
+    std::vector<RootStats> result;
+    for (const auto& move : movegen.valid_moves(board)) {
+        NodeStats child = m_table.probe(node_key_after(board, move, m_config.symmetry));
+        double value = child.visits ? double(child.reward) / child.visits : 0.0;
+        result.push_back({move, child.visits, value});
+    }
+    return result;
 }
 
 void MCTS::reset() {
-    m_stats.clear();
+    m_table.clear();
+    m_root_choice.reset();
+}
+
+void MCTS::set_tablebase(const Tablebase* tablebase) {
+    m_tablebase = tablebase;
+    m_rollouts.set_tablebase(tablebase);
 }
 
 
@@ -2,31 +2,250 @@
 #define MCTS_H_
 
 #include "board.h"
+#include "evaluator.h"
+#include "perf.h"
+#include "tablebase.h"
+#include "ttable.h"
 
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <span>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 namespace breakthrough {
 
-struct Node {
-    Board state;
-    double reward{0.0};
-    int visits{0};
-    Move move{-1, -1};
-    uint64_t parent{0};
-    std::vector<uint64_t> children;
+/**
+ * Search statistics of a position, stored in the transposition table.
+ *
+ * The reward is for the player who moved into the position.
+ */
+struct NodeStats {
+    int32_t visits{0};
+    float reward{0.0f};
+};
+
+/**
+ * Nodes with fewer visits are replaced first when the table is full.
+ */
+struct VisitsPriority {
+    int32_t operator()(NodeStats stats) const { return stats.visits; }
+};
+
+using NodeTable = TranspositionTable<NodeStats, VisitsPriority>;
+
+/**
+ * Search statistics of one of the moves at the root.
+ */
+struct RootStats {
+    Move move;
+    int visits;
+    double value;
+};
+
+/**
+ * How the moves at the root are searched.
+ */
+enum class RootPolicy {
+    /**
+     * Like the rest of the tree, with UCB1.
+     */
+    Ucb,
+
+    /**
+     * By sequential halving: the budget is split into rounds in which the
+     * remaining moves are searched equally often, and the weaker half of
+     * them is dropped after each round. The last one left is played.
+     */
+    SequentialHalving,
+};
+
+/**
+ * Parameters of the search.
+ */
+struct SearchConfig {
+    /**
+     * The number of leaves collected, under virtual loss, before they
+     * are evaluated together.
+     */
+    int batch_size{1};
+
+    /**
+     * The number of threads searching the tree together.
+     */
+    int threads{1};
+
+    /**
+     * The size of the node table in megabytes.
+     *
+     * The table is placed on the NUMA node of the thread creating the
+     * search with a single thread, and interleaved over every node with
+     * several threads.
+     */
+    std::size_t table_mb{16};
+
+    /**
+     * The seed of the evaluators' random generators, 0 for a random seed.
+     *
+     * With a fixed seed, a single thread and an iteration or node budget,
+     * the search makes the same decisions on every run and machine.
+     */
+    uint64_t seed{0};
+
+    /**
+     * The exploration constant of UCB1.
+     */
+    double exploration{1.4142135623730951};
+
+    /**
+     * The number of rollouts the default evaluator plays from each child
+     * of a leaf.
+     */
+    int n_rollouts{5};
+
+    /**
+     * The factor applied to a rollout result for each move it lasted, so
+     * that quicker wins are preferred.
+     */
+    double discount{0.99};
+
+    RootPolicy root_policy{RootPolicy::Ucb};
+
+    /**
+     * Store a position and its left-right mirror image, which have the
+     * same value, as a single node.
+     */
+    bool symmetry{false};
+};
+
+/**
+ * When to stop a search. Each limit is ignored when 0, and the search
+ * stops as soon as one of them is reached.
+ */
+struct SearchBudget {
+    /**
+     * Wall-clock time in milliseconds.
+     */
+    int ms{0};
+
+    /**
+     * Number of leaf selections.
+     */
+    long iterations{0};
+
+    /**
+     * Number of positions visited while descending the tree.
+     */
+    long nodes{0};
+};
+
+/**
+ * What a search did.
+ */
+struct SearchInfo {
+    long iterations{0};
+    long nodes{0};
+    double ms{0.0};
 };
 
 class MCTS {
 public:
-    MCTS() = default;
-    void ponder(const Board& board, int ms);
+    explicit MCTS(SearchConfig config = {});
+
+    /**
+     * Keep the node table in the given memory, of
+     * `NodeTable::bytes_for(config.table_mb)` bytes, instead of allocating
+     * it. The memory may be shared with the searches of other processes
+     * (see shared.h), and the table is only cleared if `initialize_table`
+     * is set.
+     */
+    MCTS(SearchConfig config, void* table_memory, bool initialize_table);
+    MCTS(const MCTS&) = delete;
+    MCTS& operator=(const MCTS&) = delete;
+
+    SearchInfo ponder(const Board& board, int ms);
+    SearchInfo ponder(const Board& board, SearchBudget budget);
     Move choose_best(const Board& board);
+
+    /**
+     * The statistics of the moves at the given root, in MoveGen order.
+     *
+     * Moves that have not been searched have no visits. This may be
+     * called while the search is running.
+     */
+    std::vector<RootStats> root_stats(const Board& board) const;
+
+    /**
+     * Forget every searched position, in constant time.
+     */
     void reset();
 
+    /**
+     * Evaluate the leaves with the given evaluator instead of the default
+     * random rollouts. The evaluator must outlive the search, pass nullptr
+     * to go back to the default.
+     */
+    void set_evaluator(Evaluator* evaluator) { m_evaluator = evaluator ? evaluator : &m_rollouts; }
+
+    /**
+     * Score the positions of the tablebase below the root with their
+     * exact value instead of searching them, and end the default rollouts
+     * there. The tablebase must outlive the search, pass nullptr to stop
+     * probing it.
+     */
+    void set_tablebase(const Tablebase* tablebase);
+
+    /**
+     * Where each call to `ponder` prints the per-phase totals of its
+     * search, when built with BREAKTHROUGH_PERF (see perf.h). Pass nullptr
+     * to keep the totals until `take_perf_report` instead, e.g. when a
+     * move is searched by several calls to `ponder`.
+     */
+    void set_perf_output(std::ostream* out) { m_perf_output = out; }
+
+    /**
+     * The per-phase totals of the searches since they were last printed
+     * or taken.
+     */
+    perf::Report take_perf_report();
+
+    const SearchConfig& config() const { return m_config; }
+
 private:
-    std::unordered_map<uint64_t, Node> m_stats;
+    SearchInfo ponder_halving(const Board& board, SearchBudget budget);
+
+    /**
+     * Search within the budget, playing the given root moves in turn if
+     * there are any.
+     */
+    SearchInfo run(const Board& board, SearchBudget budget, std::span<const Move> root_moves);
+
+    /**
+     * The move chosen at the root by the last search, when the root
+     * policy decides it rather than the visit counts.
+     */
+    struct RootChoice {
+        uint64_t hash;
+        int ply;
+        Move move;
+    };
+    std::optional<RootChoice> m_root_choice;
+
+    SearchConfig m_config;
+    NodeTable m_table;
+    RolloutEvaluator m_rollouts;
+    Evaluator* m_evaluator;
+    const Tablebase* m_tablebase{nullptr};
+
+    perf::Report m_perf_report;
+    std::ostream* m_perf_output{&std::cerr};
+
+    /**
+     * Draws the seeds of the search threads.
+     */
+    std::mt19937_64 m_rng;
 };
 
 } // namespace breakthrough
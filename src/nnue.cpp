@@ -0,0 +1,239 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <random>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace breakthrough {
+
+namespace {
+
+constexpr char file_magic[8] = {'B', 'T', 'N', 'N', 'U', 'E', '1', '\0'};
+
+/**
+ * Right shift applied to the second layer before its activation.
+ */
+constexpr int l2_shift = 6;
+
+/**
+ * The input feature of a piece, from the given perspective.
+ */
+inline int feature(int perspective, Square square, Piece piece) {
+    if (perspective == 0) {
+        return (is_white(piece) ? 0 : 64) + square;
+    }
+    return (is_black(piece) ? 0 : 64) + (square ^ 56);
+}
+
+/**
+ * Clipped ReLU of the accumulator, side to move first.
+ */
+void activate_l1(const Accumulator& accumulator, bool black_to_play, uint8_t* out) {
+    const int16_t* halves[2] = {accumulator.values[black_to_play], accumulator.values[!black_to_play]};
+#if defined(__AVX2__)
+    const __m256i max = _mm256_set1_epi16(127);
+    for (int h = 0; h < 2; ++h) {
+        __m256i a = _mm256_min_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(halves[h])), max);
+        __m256i b = _mm256_min_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(halves[h] + 16)), max);
+        // packus saturates negatives to 0, then fix the lane interleaving
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out + h * nnue_hidden), packed);
+    }
+#else
+    for (int h = 0; h < 2; ++h) {
+        for (int i = 0; i < nnue_hidden; ++i) {
+            out[h * nnue_hidden + i] = static_cast<uint8_t>(std::clamp<int>(halves[h][i], 0, 127));
+        }
+    }
+#endif
+}
+
+#if defined(__AVX2__)
+inline int32_t horizontal_sum(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+/**
+ * Dot product of 32 unsigned and 32 signed bytes, as 8 partial sums.
+ */
+inline __m256i dot32(__m256i in, __m256i weights) {
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(in, weights), _mm256_set1_epi16(1));
+}
+#endif
+
+}  // namespace
+
+bool Network::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return in && load(in);
+}
+
+bool Network::load(std::istream& in) {
+    char magic[sizeof(file_magic)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, file_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    Network network;
+    in.read(reinterpret_cast<char*>(network.m_l1_weights), sizeof(m_l1_weights));
+    in.read(reinterpret_cast<char*>(network.m_l1_bias), sizeof(m_l1_bias));
+    in.read(reinterpret_cast<char*>(network.m_l2_weights), sizeof(m_l2_weights));
+    in.read(reinterpret_cast<char*>(network.m_l2_bias), sizeof(m_l2_bias));
+    in.read(reinterpret_cast<char*>(network.m_out_weights), sizeof(m_out_weights));
+    in.read(reinterpret_cast<char*>(&network.m_out_bias), sizeof(m_out_bias));
+    in.read(reinterpret_cast<char*>(&network.m_out_scale), sizeof(m_out_scale));
+    if (!in) {
+        return false;
+    }
+
+    *this = network;
+    return true;
+}
+
+bool Network::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    return out && save(out);
+}
+
+bool Network::save(std::ostream& out) const {
+    out.write(file_magic, sizeof(file_magic));
+    out.write(reinterpret_cast<const char*>(m_l1_weights), sizeof(m_l1_weights));
+    out.write(reinterpret_cast<const char*>(m_l1_bias), sizeof(m_l1_bias));
+    out.write(reinterpret_cast<const char*>(m_l2_weights), sizeof(m_l2_weights));
+    out.write(reinterpret_cast<const char*>(m_l2_bias), sizeof(m_l2_bias));
+    out.write(reinterpret_cast<const char*>(m_out_weights), sizeof(m_out_weights));
+    out.write(reinterpret_cast<const char*>(&m_out_bias), sizeof(m_out_bias));
+    out.write(reinterpret_cast<const char*>(&m_out_scale), sizeof(m_out_scale));
+    return out.good();
+}
+
+void Network::randomize(unsigned int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> small(-8, 8);
+
+    for (auto& row : m_l1_weights) {
+        for (auto& w : row) {
+            w = static_cast<int16_t>(small(gen));
+        }
+    }
+    for (auto& b : m_l1_bias) {
+        b = static_cast<int16_t>(32 + small(gen));
+    }
+    for (auto& row : m_l2_weights) {
+        for (auto& w : row) {
+            w = static_cast<int8_t>(small(gen));
+        }
+    }
+    for (auto& b : m_l2_bias) {
+        b = small(gen) << l2_shift;
+    }
+    for (auto& w : m_out_weights) {
+        w = static_cast<int8_t>(small(gen));
+    }
+    m_out_bias = 0;
+}
+
+void Network::refresh(const std::array<Piece, 64>& squares, Accumulator& accumulator) const {
+    for (int p = 0; p < 2; ++p) {
+        std::copy(std::begin(m_l1_bias), std::end(m_l1_bias), accumulator.values[p]);
+    }
+    for (Square s = 0; s < 64; ++s) {
+        if (!is_empty(squares[s])) {
+            add_feature(accumulator, s, squares[s]);
+        }
+    }
+}
+
+void Network::add_feature(Accumulator& accumulator, Square square, Piece piece) const {
+    for (int p = 0; p < 2; ++p) {
+        const int16_t* weights = m_l1_weights[feature(p, square, piece)];
+        for (int i = 0; i < nnue_hidden; ++i) {
+            accumulator.values[p][i] += weights[i];
+        }
+    }
+}
+
+void Network::remove_feature(Accumulator& accumulator, Square square, Piece piece) const {
+    for (int p = 0; p < 2; ++p) {
+        const int16_t* weights = m_l1_weights[feature(p, square, piece)];
+        for (int i = 0; i < nnue_hidden; ++i) {
+            accumulator.values[p][i] -= weights[i];
+        }
+    }
+}
+
+void Network::move(Accumulator& accumulator, Move move, Piece piece, Piece captured) const {
+    remove_feature(accumulator, move.source, piece);
+    if (!is_empty(captured)) {
+        remove_feature(accumulator, move.target, captured);
+    }
+    add_feature(accumulator, move.target, piece);
+}
+
+void Network::unmove(Accumulator& accumulator, Move move, Piece piece, Piece captured) const {
+    remove_feature(accumulator, move.target, piece);
+    if (!is_empty(captured)) {
+        add_feature(accumulator, move.target, captured);
+    }
+    add_feature(accumulator, move.source, piece);
+}
+
+int32_t Network::forward(const Accumulator& accumulator, bool black_to_play) const {
+    alignas(32) uint8_t l1_out[2 * nnue_hidden];
+    alignas(32) uint8_t l2_out[nnue_hidden2];
+    activate_l1(accumulator, black_to_play, l1_out);
+
+#if defined(__AVX2__)
+    const __m256i in0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(l1_out));
+    const __m256i in1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(l1_out + 32));
+    for (int o = 0; o < nnue_hidden2; ++o) {
+        const __m256i w0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m_l2_weights[o]));
+        const __m256i w1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(m_l2_weights[o] + 32));
+        int32_t sum = m_l2_bias[o] + horizontal_sum(_mm256_add_epi32(dot32(in0, w0), dot32(in1, w1)));
+        l2_out[o] = static_cast<uint8_t>(std::clamp(sum >> l2_shift, 0, 127));
+    }
+    const __m256i out_in = _mm256_load_si256(reinterpret_cast<const __m256i*>(l2_out));
+    const __m256i out_w = _mm256_load_si256(reinterpret_cast<const __m256i*>(m_out_weights));
+    return m_out_bias + horizontal_sum(dot32(out_in, out_w));
+#else
+    for (int o = 0; o < nnue_hidden2; ++o) {
+        int32_t sum = m_l2_bias[o];
+        for (int i = 0; i < 2 * nnue_hidden; ++i) {
+            sum += l1_out[i] * m_l2_weights[o][i];
+        }
+        l2_out[o] = static_cast<uint8_t>(std::clamp(sum >> l2_shift, 0, 127));
+    }
+    int32_t score = m_out_bias;
+    for (int i = 0; i < nnue_hidden2; ++i) {
+        score += l2_out[i] * m_out_weights[i];
+    }
+    return score;
+#endif
+}
+
+int32_t Network::score(const Board& board) const {
+    const bool black_to_play = board.ply() & 1;
+    if (board.network() == this) {
+        return forward(board.accumulator(), black_to_play);
+    }
+    Accumulator accumulator;
+    refresh(board.squares(), accumulator);
+    return forward(accumulator, black_to_play);
+}
+
+double Network::evaluate(const Board& board) const {
+    return std::tanh(score(board) * m_out_scale);
+}
+
+}  // namespace breakthrough
@@ -0,0 +1,114 @@
+/**
+ * @file nnue.h
+ *
+ * A small quantised network evaluating positions for the leaves of the
+ * search, in the spirit of NNUE.
+ *
+ * The inputs are the 128 piece-square features (own and opponent pawns
+ * on each of the 64 squares) seen from each side's perspective. The first
+ * layer is kept in an `Accumulator` which boards update incrementally as
+ * moves are played, so an evaluation only costs the two small layers on
+ * top of it:
+ *
+ *   accumulator (2 x 32, int16) -> clipped ReLU -> 64 x int8
+ *   -> dense (32, int8 weights) -> clipped ReLU -> 32 x int8
+ *   -> dense (1, int8 weights) -> score
+ *
+ * The accumulator of the side to move comes first in the second layer's
+ * input. When compiled for AVX2 the dense layers use SIMD kernels.
+ */
+
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include "accumulator.h"
+#include "board.h"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace breakthrough {
+
+/**
+ * The number of input features for each perspective.
+ */
+constexpr int nnue_inputs = 128;
+
+/**
+ * The number of second-layer neurons.
+ */
+constexpr int nnue_hidden2 = 32;
+
+class Network {
+public:
+    Network() = default;
+
+    /**
+     * Read the weights from a file written by `save`.
+     *
+     * Returns false and leaves the network unchanged if the file is
+     * missing or malformed.
+     */
+    bool load(const std::string& path);
+    bool load(std::istream& in);
+
+    /**
+     * Write the weights to a file.
+     */
+    bool save(const std::string& path) const;
+    bool save(std::ostream& out) const;
+
+    /**
+     * Fill the network with small random weights, for tests and as a
+     * starting point for training.
+     */
+    void randomize(unsigned int seed);
+
+    /**
+     * Compute the first layer from scratch.
+     */
+    void refresh(const std::array<Piece, 64>& squares, Accumulator& accumulator) const;
+
+    /**
+     * Update the first layer for a move of `piece`, capturing `captured`.
+     */
+    void move(Accumulator& accumulator, Move move, Piece piece, Piece captured) const;
+
+    /**
+     * Revert the update made by `move`.
+     */
+    void unmove(Accumulator& accumulator, Move move, Piece piece, Piece captured) const;
+
+    /**
+     * The raw output of the network for the side to move.
+     */
+    int32_t score(const Board& board) const;
+
+    /**
+     * The expected result for the side to move, between -1 and 1.
+     */
+    double evaluate(const Board& board) const;
+
+private:
+    void add_feature(Accumulator& accumulator, Square square, Piece piece) const;
+    void remove_feature(Accumulator& accumulator, Square square, Piece piece) const;
+    int32_t forward(const Accumulator& accumulator, bool black_to_play) const;
+
+    alignas(32) int16_t m_l1_weights[nnue_inputs][nnue_hidden]{};
+    alignas(32) int16_t m_l1_bias[nnue_hidden]{};
+    alignas(32) int8_t m_l2_weights[nnue_hidden2][2 * nnue_hidden]{};
+    alignas(32) int32_t m_l2_bias[nnue_hidden2]{};
+    alignas(32) int8_t m_out_weights[nnue_hidden2]{};
+    int32_t m_out_bias{0};
+
+    /**
+     * Converts the output to the argument of tanh.
+     */
+    float m_out_scale{1.0f / 4096};
+};
+
+}  // namespace breakthrough
+
+#endif // NNUE_H_
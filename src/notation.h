@@ -0,0 +1,60 @@
+/**
+ * @file notation.h
+ *
+ * Conversion between squares/moves and their algebraic notation,
+ * e.g. the move from 'd2' to 'e3' is written "d2e3".
+ */
+
+#ifndef NOTATION_H_
+#define NOTATION_H_
+
+#include "board.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace breakthrough {
+
+/**
+ * The algebraic name of a square, 'a1' for 0 up to 'h8' for 63.
+ */
+inline std::string to_string(Square square) {
+    return {char('a' + square % 8), char('1' + square / 8)};
+}
+
+/**
+ * The algebraic notation of a move, e.g. "d2e3".
+ */
+inline std::string to_string(Move move) {
+    return to_string(move.source) + to_string(move.target);
+}
+
+/**
+ * Parse a square name, returning nothing if it is malformed.
+ */
+inline std::optional<Square> parse_square(std::string_view s) {
+    if (s.size() < 2 || s[0] < 'a' || s[0] > 'h' || s[1] < '1' || s[1] > '8') {
+        return std::nullopt;
+    }
+    return (s[0] - 'a') + (s[1] - '1') * 8;
+}
+
+/**
+ * Parse a move in algebraic notation, returning nothing if it is malformed.
+ */
+inline std::optional<Move> parse_move(std::string_view s) {
+    if (s.size() < 4) {
+        return std::nullopt;
+    }
+    auto source = parse_square(s.substr(0, 2));
+    auto target = parse_square(s.substr(2, 2));
+    if (!source || !target) {
+        return std::nullopt;
+    }
+    return Move{*source, *target};
+}
+
+}  // namespace breakthrough
+
+#endif // NOTATION_H_
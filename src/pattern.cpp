@@ -0,0 +1,151 @@
+#include "pattern.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace breakthrough {
+
+namespace {
+
+/**
+ * Header of a pattern weights file, followed by `n_patterns` floats.
+ */
+struct FileHeader {
+    char magic[8];
+    uint32_t count;
+    uint32_t reserved;
+};
+
+constexpr char file_magic[8] = {'B', 'T', 'P', 'A', 'T', 'T', '1', '\0'};
+
+}  // namespace
+
+int pattern_code(const Board& board, Move move) {
+    const bool black_to_play = board.ply() & 1;
+    const Piece own = black_to_play ? Piece::BLACK : Piece::WHITE;
+    const int forward = black_to_play ? -1 : 1;
+
+    const int rank = move.target / 8;
+    const int file = move.target % 8;
+    const int move_df = file - move.source % 8;
+    const int capture = !is_empty(board.at(move.target));
+
+    int cells = 0;
+    for (int dr = 1; dr >= -1; --dr) {
+        for (int df = -1; df <= 1; ++df) {
+            // Skip the target itself and the square the piece comes from
+            if ((dr == 0 && df == 0) || (dr == -1 && df == -move_df)) {
+                continue;
+            }
+            int r = rank + dr * forward;
+            int f = file + df;
+            int cell = 3;
+            if (r >= 0 && r < 8 && f >= 0 && f < 8) {
+                Piece piece = board.at(r * 8 + f);
+                cell = is_empty(piece) ? 0 : piece == own ? 1 : 2;
+            }
+            cells = (cells << 2) | cell;
+        }
+    }
+
+    return (((move_df + 1) * 2 + capture) << 14) | cells;
+}
+
+PatternTable::PatternTable()
+    : m_owned(n_patterns, 1.0f)
+{
+    m_weights = m_owned.data();
+}
+
+PatternTable::~PatternTable() {
+    unmap();
+}
+
+void PatternTable::unmap() {
+    if (m_mapping) {
+        munmap(m_mapping, m_mapping_size);
+        m_mapping = nullptr;
+        m_mapping_size = 0;
+    }
+}
+
+bool PatternTable::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    const std::size_t expected_size = sizeof(FileHeader) + n_patterns * sizeof(float);
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != expected_size) {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, expected_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const auto* header = static_cast<const FileHeader*>(mapping);
+    if (std::memcmp(header->magic, file_magic, sizeof(file_magic)) != 0 ||
+        header->count != n_patterns) {
+        munmap(mapping, expected_size);
+        return false;
+    }
+
+    unmap();
+    m_mapping = mapping;
+    m_mapping_size = expected_size;
+    m_weights = reinterpret_cast<const float*>(header + 1);
+    m_owned.clear();
+    m_owned.shrink_to_fit();
+
+    return true;
+}
+
+bool PatternTable::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    FileHeader header{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.count = n_patterns;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(m_weights), n_patterns * sizeof(float));
+    return out.good();
+}
+
+void PatternTable::set_weight(int code, float weight) {
+    if (m_mapping) {
+        m_owned.assign(m_weights, m_weights + n_patterns);
+        m_weights = m_owned.data();
+        unmap();
+    }
+    m_owned[code] = weight;
+}
+
+Move PatternTable::sample(const Board& board, const std::vector<Move>& moves, std::mt19937& gen) const {
+    thread_local std::vector<float> cumulative;
+    cumulative.resize(moves.size());
+
+    float total = 0.0f;
+    for (std::size_t i = 0; i < moves.size(); ++i) {
+        total += m_weights[pattern_code(board, moves[i])];
+        cumulative[i] = total;
+    }
+
+    std::uniform_real_distribution<float> dis(0.0f, total);
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(), dis(gen));
+    if (it == cumulative.end()) {
+        --it;
+    }
+    return moves[it - cumulative.begin()];
+}
+
+}  // namespace breakthrough
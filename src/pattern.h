@@ -0,0 +1,104 @@
+/**
+ * @file pattern.h
+ *
+ * Local patterns used to bias the moves played during rollouts.
+ *
+ * A candidate move is described by the 3x3 window centered on its
+ * target square, seen from the side to move: each of the neighbouring
+ * squares (except the source square) is empty, own, opponent or off
+ * the board, and the move is either straight or diagonal and either a
+ * capture or not. Those are packed into a small integer, the pattern
+ * code, which indexes a flat table of weights.
+ *
+ * The weights are learned offline (see main_train_patterns.cpp) and
+ * memory-mapped from a file at startup.
+ */
+
+#ifndef PATTERN_H_
+#define PATTERN_H_
+
+#include "board.h"
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace breakthrough {
+
+/**
+ * The number of distinct pattern codes.
+ *
+ * 3 move directions, capture or not, and 7 neighbours with 4 states each.
+ */
+constexpr int n_patterns = 3 * 2 * (1 << 14);
+
+/**
+ * Compute the pattern code of a move for the side to move.
+ *
+ * The code is relative to the side to move, so that white and black
+ * share the same weights.
+ */
+int pattern_code(const Board& board, Move move);
+
+class PatternTable {
+public:
+    /**
+     * Create a table with uniform weights.
+     */
+    PatternTable();
+
+    ~PatternTable();
+
+    PatternTable(const PatternTable&) = delete;
+    PatternTable& operator=(const PatternTable&) = delete;
+
+    /**
+     * Memory-map the weights from a file written by `save`.
+     *
+     * Returns false and leaves the table unchanged if the file is
+     * missing or malformed.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * Write the weights to a file.
+     */
+    bool save(const std::string& path) const;
+
+    /**
+     * The weight of the given pattern code.
+     */
+    float weight(int code) const { return m_weights[code]; }
+
+    /**
+     * Modify the weight of the given pattern code.
+     *
+     * If the table was memory-mapped, the weights are first copied.
+     */
+    void set_weight(int code, float weight);
+
+    /**
+     * Sample one of the moves with probability proportional to its weight.
+     *
+     * The moves must be valid moves for the side to move of the board.
+     */
+    Move sample(const Board& board, const std::vector<Move>& moves, std::mt19937& gen) const;
+
+private:
+    void unmap();
+
+    /**
+     * Points either to `m_owned` or to the memory-mapped file.
+     */
+    const float* m_weights;
+
+    std::vector<float> m_owned;
+
+    void* m_mapping{nullptr};
+    std::size_t m_mapping_size{0};
+};
+
+}  // namespace breakthrough
+
+#endif // PATTERN_H_
@@ -0,0 +1,226 @@
+#include "perf.h"
+
+#include <iomanip>
+#include <ostream>
+
+#ifdef BREAKTHROUGH_PERF
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace breakthrough::perf {
+
+namespace {
+
+const char* phase_names[] = {"select", "virtual-loss", "evaluate", "backpropagate"};
+
+}  // namespace
+
+void Report::print(std::ostream& out) const {
+    out << std::left << std::setw(14) << "phase"
+        << std::right << std::setw(10) << "calls"
+        << std::setw(12) << "ms"
+        << std::setw(14) << "cycles";
+    if (hardware) {
+        out << std::setw(14) << "instructions"
+            << std::setw(8) << "IPC"
+            << std::setw(14) << "cache-misses"
+            << std::setw(14) << "branch-misses";
+    }
+    out << '\n';
+
+    for (int p = 0; p < static_cast<int>(Phase::Count); ++p) {
+        const Counters& c = phases[p];
+        out << std::left << std::setw(14) << phase_names[p]
+            << std::right << std::setw(10) << c.calls
+            << std::setw(12) << std::fixed << std::setprecision(2) << c.nanoseconds / 1e6
+            << std::setw(14) << c.cycles;
+        if (hardware) {
+            double ipc = c.cycles ? double(c.instructions) / c.cycles : 0.0;
+            out << std::setw(14) << c.instructions
+                << std::setw(8) << std::setprecision(2) << ipc
+                << std::setw(14) << c.cache_misses
+                << std::setw(14) << c.branch_misses;
+        }
+        out << '\n';
+    }
+}
+
+#ifdef BREAKTHROUGH_PERF
+
+namespace {
+
+/**
+ * The hardware counters and phase totals of one thread.
+ *
+ * Scopes start and end several times per iteration, so the counters are
+ * read in user space with rdpmc, through the page the kernel maps for
+ * each event, rather than with a read() system call each time. The
+ * system call remains the fallback when the kernel does not allow rdpmc
+ * or an event is not on a hardware counter at the moment.
+ */
+struct ThreadCounters {
+    static constexpr int n_events = 3;
+
+    ThreadCounters() {
+        const uint64_t configs[n_events] = {
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for (int i = 0; i < n_events; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            // Count for this thread on any cpu, grouped under the first event
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+            if (fds[i] < 0) {
+                close_all();
+                return;
+            }
+            void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds[i], 0);
+            pages[i] = page == MAP_FAILED ? nullptr : static_cast<const perf_event_mmap_page*>(page);
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        hardware = true;
+    }
+
+    ~ThreadCounters() {
+        close_all();
+    }
+
+    void close_all() {
+        for (int i = 0; i < n_events; ++i) {
+            if (pages[i]) {
+                munmap(const_cast<perf_event_mmap_page*>(pages[i]), sysconf(_SC_PAGESIZE));
+                pages[i] = nullptr;
+            }
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+            fds[i] = -1;
+        }
+        hardware = false;
+    }
+
+    /**
+     * Read an event's count with rdpmc, following the protocol documented
+     * in linux/perf_event.h. Returns false if the event cannot be read
+     * from user space right now.
+     */
+    bool read_user(int event, uint64_t& count) const {
+#if defined(__x86_64__) || defined(__i386__)
+        const volatile perf_event_mmap_page* page = pages[event];
+        if (!page) {
+            return false;
+        }
+        uint32_t sequence;
+        do {
+            sequence = page->lock;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            const uint32_t index = page->index;
+            if (!page->cap_user_rdpmc || index == 0) {
+                return false;
+            }
+            const int width = page->pmc_width;
+            int64_t value = __rdpmc(index - 1);
+            value = static_cast<int64_t>(static_cast<uint64_t>(value) << (64 - width)) >> (64 - width);
+            count = page->offset + value;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } while (page->lock != sequence);
+        return true;
+#else
+        (void)event;
+        (void)count;
+        return false;
+#endif
+    }
+
+    /**
+     * Sample the clock, the TSC and the hardware counters.
+     */
+    void sample(uint64_t out[5]) const {
+        out[0] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#if defined(__x86_64__) || defined(__i386__)
+        out[1] = __rdtsc();
+#else
+        out[1] = 0;
+#endif
+        out[2] = out[3] = out[4] = 0;
+        if (hardware) {
+            if (read_user(0, out[2]) && read_user(1, out[3]) && read_user(2, out[4])) {
+                return;
+            }
+            uint64_t buffer[1 + n_events];
+            if (::read(fds[0], buffer, sizeof(buffer)) == sizeof(buffer)) {
+                out[2] = buffer[1];
+                out[3] = buffer[2];
+                out[4] = buffer[3];
+            }
+        }
+    }
+
+    int fds[n_events] = {-1, -1, -1};
+    const perf_event_mmap_page* pages[n_events] = {nullptr, nullptr, nullptr};
+    bool hardware{false};
+    Counters totals[static_cast<int>(Phase::Count)];
+};
+
+thread_local ThreadCounters thread_counters;
+
+}  // namespace
+
+Scope::Scope(Phase phase) : m_phase(phase) {
+    thread_counters.sample(m_start);
+}
+
+Scope::~Scope() {
+    uint64_t end[5];
+    thread_counters.sample(end);
+    Counters& c = thread_counters.totals[static_cast<int>(m_phase)];
+    ++c.calls;
+    c.nanoseconds += end[0] - m_start[0];
+    c.cycles += end[1] - m_start[1];
+    c.instructions += end[2] - m_start[2];
+    c.cache_misses += end[3] - m_start[3];
+    c.branch_misses += end[4] - m_start[4];
+}
+
+void collect(Report& report) {
+    for (int p = 0; p < static_cast<int>(Phase::Count); ++p) {
+        Counters& from = thread_counters.totals[p];
+        Counters& to = report.phases[p];
+        to.calls += from.calls;
+        to.nanoseconds += from.nanoseconds;
+        to.cycles += from.cycles;
+        to.instructions += from.instructions;
+        to.cache_misses += from.cache_misses;
+        to.branch_misses += from.branch_misses;
+        from = Counters{};
+    }
+    report.hardware &= thread_counters.hardware;
+}
+
+#endif
+
+}  // namespace breakthrough::perf
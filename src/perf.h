@@ -0,0 +1,103 @@
+/**
+ * @file perf.h
+ *
+ * Optional per-phase instrumentation of the search.
+ *
+ * When compiled with BREAKTHROUGH_PERF (the BREAKTHROUGH_PERF_COUNTERS
+ * CMake option), each phase of an iteration wrapped in PERF_SCOPE counts
+ * its calls, wall time, TSC cycles and, when the kernel lets us open
+ * them, the hardware instructions, cache misses and branch misses of the
+ * calling thread. Otherwise PERF_SCOPE expands to nothing and costs
+ * nothing.
+ */
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <cstdint>
+#include <iosfwd>
+
+namespace breakthrough::perf {
+
+/**
+ * The phases of a search iteration.
+ */
+enum class Phase {
+    /**
+     * Descending to a leaf and checking if the game is over there.
+     */
+    Select,
+
+    /**
+     * Adding the virtual loss along the path, which inserts the leaf.
+     */
+    VirtualLoss,
+
+    Evaluate,
+    Backpropagate,
+    Count
+};
+
+/**
+ * Totals of one phase.
+ */
+struct Counters {
+    uint64_t calls{0};
+    uint64_t nanoseconds{0};
+    uint64_t cycles{0};
+    uint64_t instructions{0};
+    uint64_t cache_misses{0};
+    uint64_t branch_misses{0};
+};
+
+/**
+ * Totals of all phases, possibly from several threads.
+ */
+struct Report {
+    Counters phases[static_cast<int>(Phase::Count)];
+
+    /**
+     * Whether the hardware counters were available on every thread.
+     */
+    bool hardware{true};
+
+    void print(std::ostream& out) const;
+};
+
+#ifdef BREAKTHROUGH_PERF
+
+/**
+ * Measures the enclosing scope and adds it to the calling thread's totals.
+ */
+class Scope {
+public:
+    explicit Scope(Phase phase);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Phase m_phase;
+    uint64_t m_start[5];
+};
+
+/**
+ * Move the calling thread's totals into the report and reset them.
+ * The report must not be shared between threads meanwhile.
+ */
+void collect(Report& report);
+
+#define PERF_CONCAT_IMPL(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_IMPL(a, b)
+#define PERF_SCOPE(phase) ::breakthrough::perf::Scope PERF_CONCAT(perf_scope_, __LINE__)(phase)
+
+#else
+
+#define PERF_SCOPE(phase) ((void)0)
+
+#endif
+
+}  // namespace breakthrough::perf
+
+#endif // PERF_H_
@@ -0,0 +1,78 @@
+#include "record.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace breakthrough {
+
+PositionRecord make_record(const Board& board, const std::vector<int>& move_visits) {
+    assert(move_visits.size() <= max_moves && "Too many moves for a record");
+
+    PositionRecord record{};
+    record.white = board.bitboard(Piece::WHITE);
+    record.black = board.bitboard(Piece::BLACK);
+    record.ply = static_cast<uint16_t>(board.ply());
+    record.n_moves = static_cast<uint8_t>(move_visits.size());
+
+    uint64_t total = 0;
+    for (auto visits : move_visits) {
+        total += visits;
+    }
+    record.total_visits = static_cast<uint32_t>(std::min<uint64_t>(total, UINT32_MAX));
+
+    if (total > 0) {
+        for (std::size_t i = 0; i < move_visits.size(); ++i) {
+            record.visits[i] = static_cast<uint16_t>((65535 * static_cast<uint64_t>(move_visits[i]) + total / 2) / total);
+        }
+    }
+    return record;
+}
+
+RecordWriter::RecordWriter(const std::string& path)
+    : m_out(path, std::ios::binary | std::ios::app)
+{
+}
+
+void RecordWriter::write(const std::vector<PositionRecord>& records) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(PositionRecord));
+    m_out.flush();
+}
+
+RecordFile::RecordFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size % sizeof(PositionRecord) != 0) {
+        close(fd);
+        return;
+    }
+    m_size = st.st_size / sizeof(PositionRecord);
+    if (m_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            m_size = 0;
+            close(fd);
+            return;
+        }
+        m_records = static_cast<const PositionRecord*>(mapping);
+    }
+    close(fd);
+    m_ok = true;
+}
+
+RecordFile::~RecordFile() {
+    if (m_records) {
+        munmap(const_cast<PositionRecord*>(m_records), m_size * sizeof(PositionRecord));
+    }
+}
+
+}  // namespace breakthrough
@@ -0,0 +1,128 @@
+/**
+ * @file record.h
+ *
+ * Compact binary records of self-play positions.
+ *
+ * A record file is a plain sequence of fixed-size `PositionRecord`s
+ * without any header, so that it can be appended to while games are
+ * being played and memory-mapped for random access afterwards.
+ */
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include "board.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace breakthrough {
+
+/**
+ * One position of a self-play game.
+ */
+struct PositionRecord {
+    /**
+     * Bitboards of the white and black pieces.
+     */
+    uint64_t white;
+    uint64_t black;
+
+    /**
+     * The ply of the position, its parity gives the side to move.
+     */
+    uint16_t ply;
+
+    /**
+     * The final result for the side to move: 1 for a win, -1 for a loss.
+     */
+    int8_t result;
+
+    /**
+     * The number of valid moves in the position.
+     */
+    uint8_t n_moves;
+
+    /**
+     * The number of visits of the root during the search.
+     */
+    uint32_t total_visits;
+
+    /**
+     * The fraction of root visits spent on each valid move, in MoveGen
+     * order and scaled so that 65535 is all of them.
+     */
+    uint16_t visits[max_moves];
+
+    uint8_t reserved[8];
+
+    /**
+     * Reconstruct the board of the position.
+     */
+    Board board() const { return Board(white, black, ply); }
+
+    /**
+     * The fraction of the visits spent on the i-th valid move.
+     */
+    double policy(int i) const { return visits[i] / 65535.0; }
+};
+
+static_assert(sizeof(PositionRecord) == 128, "PositionRecord should fill two cache lines");
+
+/**
+ * Fill a record from a position and the visit counts of its valid moves.
+ */
+PositionRecord make_record(const Board& board, const std::vector<int>& move_visits);
+
+/**
+ * Appends records to a file, safe to share between threads.
+ */
+class RecordWriter {
+public:
+    explicit RecordWriter(const std::string& path);
+
+    operator bool() const { return static_cast<bool>(m_out); }
+
+    /**
+     * Append the records of a game in one go.
+     */
+    void write(const std::vector<PositionRecord>& records);
+
+private:
+    std::mutex m_mutex;
+    std::ofstream m_out;
+};
+
+/**
+ * Read-only memory-mapped view of a record file.
+ */
+class RecordFile {
+public:
+    explicit RecordFile(const std::string& path);
+    ~RecordFile();
+
+    RecordFile(const RecordFile&) = delete;
+    RecordFile& operator=(const RecordFile&) = delete;
+
+    operator bool() const { return m_ok; }
+
+    std::size_t size() const { return m_size; }
+
+    const PositionRecord& operator[](std::size_t i) const { return m_records[i]; }
+
+    const PositionRecord* begin() const { return m_records; }
+    const PositionRecord* end() const { return m_records + m_size; }
+
+private:
+    const PositionRecord* m_records{nullptr};
+    std::size_t m_size{0};
+    bool m_ok{false};
+};
+
+}  // namespace breakthrough
+
+#endif // RECORD_H_
@@ -0,0 +1,185 @@
+#include "server.h"
+#include "board.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "notation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace breakthrough {
+
+namespace {
+
+/**
+ * The longest a session searches before letting other sessions run.
+ */
+constexpr int slice_ms = 5;
+
+/**
+ * Orders a heap of sessions with the earliest deadline on top.
+ */
+constexpr auto later_deadline = [](const auto& a, const auto& b) {
+    return a->deadline > b->deadline;
+};
+
+}  // namespace
+
+struct Server::Session {
+    Session(std::string id, const SearchConfig& config) : id(std::move(id)), mcts(config) {}
+
+    std::string id;
+    Board board;
+    MCTS mcts;
+    std::chrono::steady_clock::time_point deadline;
+
+    /**
+     * Guarded by the server's mutex.
+     */
+    bool searching{false};
+    bool closed{false};
+};
+
+Server::Server(ThreadPool& pool, Output output, const SearchConfig& config)
+    : m_pool(pool), m_output(std::move(output)), m_config(config)
+{
+}
+
+Server::~Server() {
+    wait();
+}
+
+void Server::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_searches == 0; });
+}
+
+std::shared_ptr<Server::Session> Server::find(const std::string& id) {
+    auto it = m_sessions.find(id);
+    return it == m_sessions.end() ? nullptr : it->second;
+}
+
+void Server::handle(const std::string& line) {
+    std::istringstream in(line);
+    std::string command, id, argument;
+    in >> command >> id >> argument;
+    if (command.empty()) {
+        return;
+    }
+    if (id.empty()) {
+        m_output("error - missing session id");
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto session = find(id);
+
+    if (session && session->searching && command != "close") {
+        m_output("error " + id + " busy");
+        return;
+    }
+
+    if (command == "new") {
+        auto created = std::make_shared<Session>(id, m_config);
+        // A move is searched in many slices, its totals are printed once
+        created->mcts.set_perf_output(nullptr);
+        m_sessions[id] = created;
+        m_output("ok " + id);
+    } else if (!session) {
+        m_output("error " + id + " unknown session");
+    } else if (command == "close") {
+        session->closed = true;
+        m_sessions.erase(id);
+        m_output("ok " + id);
+    } else if (command == "play") {
+        auto move = parse_move(argument);
+        MoveGen movegen;
+        const auto& valid_moves = movegen.valid_moves(session->board);
+        bool valid = move && std::any_of(valid_moves.begin(), valid_moves.end(), [&](const Move& m) {
+            return m.source == move->source && m.target == move->target;
+        });
+        if (!valid) {
+            m_output("error " + id + " invalid move");
+            return;
+        }
+        session->board.play(*move);
+        m_output("ok " + id);
+    } else if (command == "go") {
+        int ms = std::atoi(argument.c_str());
+        MoveGen movegen;
+        if (ms <= 0) {
+            m_output("error " + id + " invalid time");
+            return;
+        }
+        if (movegen.valid_moves(session->board).empty()) {
+            m_output("error " + id + " game over");
+            return;
+        }
+        session->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        session->searching = true;
+        ++m_searches;
+        schedule(session);
+    } else {
+        m_output("error " + id + " unknown command " + command);
+    }
+}
+
+void Server::schedule(std::shared_ptr<Session> session) {
+    m_ready.push_back(std::move(session));
+    std::push_heap(m_ready.begin(), m_ready.end(), later_deadline);
+    m_pool.submit([this]() { search(); });
+}
+
+void Server::search() {
+    using namespace std::chrono;
+
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::pop_heap(m_ready.begin(), m_ready.end(), later_deadline);
+        session = std::move(m_ready.back());
+        m_ready.pop_back();
+
+        // Closed sessions stop at their next slice instead of their deadline
+        if (session->closed) {
+            end_search(*session);
+            return;
+        }
+    }
+
+    // A slice that starts late, behind other sessions, only replies
+    auto remaining = duration_cast<milliseconds>(session->deadline - steady_clock::now()).count();
+    if (remaining > 0) {
+        session->mcts.ponder(session->board, std::min<int>(remaining, slice_ms));
+    }
+
+    if (steady_clock::now() < session->deadline) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        schedule(session);
+        return;
+    }
+
+    Move move = session->mcts.choose_best(session->board);
+    session->board.play(move);
+#ifdef BREAKTHROUGH_PERF
+    session->mcts.take_perf_report().print(std::cerr);
+#endif
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!session->closed) {
+        m_output("bestmove " + session->id + " " + to_string(move));
+    }
+    end_search(*session);
+}
+
+void Server::end_search(Session& session) {
+    session.searching = false;
+    if (--m_searches == 0) {
+        m_idle.notify_all();
+    }
+}
+
+}  // namespace breakthrough
@@ -0,0 +1,110 @@
+/**
+ * @file server.h
+ *
+ * Line-based protocol serving many games at once.
+ *
+ * Every game session has its own board and search tree, and the searches
+ * of all the sessions run in small time slices on one shared thread pool
+ * until their deadline, the session with the earliest deadline first.
+ * Commands, one per line:
+ *
+ *   new <id>           start a game from the initial position
+ *   play <id> <move>   play a move, e.g. "play g1 d2d3"
+ *   go <id> <ms>       search for <ms> milliseconds, play and print the best move
+ *   close <id>         end the game
+ *
+ * Replies are "ok <id>", "bestmove <id> <move>" or "error <id> <reason>".
+ * The bestmove replies come asynchronously, possibly interleaved with
+ * the replies to other commands.
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "mcts.h"
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace breakthrough {
+
+class Server {
+public:
+    /**
+     * Receives the reply lines, without their newline. It may be called
+     * from the pool's threads.
+     */
+    using Output = std::function<void(const std::string&)>;
+
+    /**
+     * The pool must outlive the server. Each session searches with the
+     * given configuration, so its table size bounds the memory of every
+     * game.
+     */
+    Server(ThreadPool& pool, Output output, const SearchConfig& config = {});
+
+    /**
+     * Wait for the searches in progress to finish.
+     */
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /**
+     * Handle one command line.
+     */
+    void handle(const std::string& line);
+
+    /**
+     * Block until no search is in progress.
+     */
+    void wait();
+
+private:
+    struct Session;
+
+    /**
+     * Queue a time slice of the session's search. The mutex must be held.
+     */
+    void schedule(std::shared_ptr<Session> session);
+
+    /**
+     * Run one time slice of the search with the earliest deadline, and
+     * requeue it until its deadline.
+     */
+    void search();
+
+    /**
+     * Mark the session's search as over. The mutex must be held.
+     */
+    void end_search(Session& session);
+
+    std::shared_ptr<Session> find(const std::string& id);
+
+    ThreadPool& m_pool;
+    Output m_output;
+    SearchConfig m_config;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Session>> m_sessions;
+
+    /**
+     * The sessions waiting for their next slice, a heap on their deadline
+     * with one pool task queued for each.
+     */
+    std::vector<std::shared_ptr<Session>> m_ready;
+
+    std::condition_variable m_idle;
+    int m_searches{0};
+};
+
+}  // namespace breakthrough
+
+#endif // SERVER_H_
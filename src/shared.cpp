@@ -0,0 +1,396 @@
+#include "shared.h"
+#include "movegen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace breakthrough {
+
+namespace {
+
+constexpr char segment_magic[8] = {'B', 'T', 'S', 'H', 'M', '2', '\0', '\0'};
+
+/**
+ * How long helpers wait for the leader to create the segment.
+ */
+constexpr auto open_timeout = std::chrono::seconds(10);
+
+constexpr auto poll_interval = std::chrono::milliseconds(1);
+
+constexpr std::size_t page_size = 4096;
+
+/**
+ * Root statistics packed in one atomic word.
+ */
+struct PackedStats {
+    int32_t visits;
+    float value;
+};
+
+const std::filesystem::path numa_root = "/sys/devices/system/node";
+
+bool process_alive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+}  // namespace
+
+/**
+ * The start of the segment, written by the leader and followed by the
+ * slots of the processes.
+ */
+struct alignas(64) SharedSearch::Header {
+    char magic[8];
+    uint32_t n_processes;
+    uint32_t table_mb;
+    int32_t leader_pid;
+
+    /**
+     * Set by the leader once the rest of the header is written.
+     */
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> stop;
+
+    /**
+     * The current job and its generation, under a sequence lock like the
+     * slots.
+     */
+    std::atomic<uint64_t> job_sequence;
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> white;
+    std::atomic<uint64_t> black;
+    std::atomic<int32_t> ply;
+    std::atomic<int32_t> ms;
+    std::atomic<int64_t> iterations;
+    std::atomic<int64_t> nodes;
+};
+
+/**
+ * The root statistics published by one process, under a sequence lock:
+ * the sequence is odd while they are being written.
+ */
+struct alignas(64) SharedSearch::Slot {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> generation;
+    std::atomic<uint32_t> n_moves;
+    std::atomic<uint64_t> stats[max_moves];
+};
+
+int numa_node_count() {
+    int count = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(numa_root, error)) {
+        const std::string name = entry.path().filename();
+        if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+            std::all_of(name.begin() + 4, name.end(), [](char c) { return std::isdigit(c); })) {
+            ++count;
+        }
+    }
+    return std::max(count, 1);
+}
+
+bool pin_to_numa_node(int node) {
+    // The CPUs of the node as a list of ranges, e.g. "0-7,16-23"
+    std::ifstream in(numa_root / ("node" + std::to_string(node)) / "cpulist");
+    std::string cpulist;
+    if (!std::getline(in, cpulist)) {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::istringstream ranges(cpulist);
+    std::string range;
+    int n_cpus = 0;
+    while (std::getline(ranges, range, ',')) {
+        const auto dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+                CPU_SET(cpu, &cpus);
+                ++n_cpus;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return n_cpus > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+SharedSearch::SharedSearch(const std::string& name, int n_processes, int slot, std::size_t table_mb)
+    : m_slot(slot),
+      m_name(name)
+{
+    if (slot < 0 || (slot == 0 && n_processes < 1)) {
+        return;
+    }
+
+    int fd = -1;
+    if (slot == 0) {
+        // Start from a new segment rather than one left by a crashed run
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            return;
+        }
+        const std::size_t size = table_offset(n_processes) + (table_mb ? NodeTable::bytes_for(table_mb) : 0);
+        void* mapping = ftruncate(fd, size) == 0
+            ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            return;
+        }
+
+        // The new segment is zero-filled, which is a valid empty node table
+        auto* header = new (mapping) Header();
+        std::memcpy(header->magic, segment_magic, sizeof(segment_magic));
+        header->n_processes = n_processes;
+        header->table_mb = table_mb;
+        header->leader_pid = getpid();
+
+        m_header = header;
+        m_size = size;
+        m_n_processes = n_processes;
+        m_table_mb = table_mb;
+        m_table = table_mb ? static_cast<char*>(mapping) + table_offset(n_processes) : nullptr;
+        for (int i = 0; i < n_processes; ++i) {
+            new (&slot_at(i)) Slot();
+        }
+        header->ready.store(1, std::memory_order_release);
+        return;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + open_timeout;
+    for (; std::chrono::steady_clock::now() < deadline; std::this_thread::sleep_for(10 * poll_interval)) {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        void* mapping = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(Header)) {
+            mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            continue;
+        }
+
+        // Skip segments not ready yet, or left by a leader that is gone
+        auto* header = static_cast<Header*>(mapping);
+        const bool valid = header->ready.load(std::memory_order_acquire) &&
+            std::memcmp(header->magic, segment_magic, sizeof(segment_magic)) == 0 &&
+            slot < static_cast<int>(header->n_processes) && process_alive(header->leader_pid) &&
+            static_cast<std::size_t>(st.st_size) >= table_offset(header->n_processes) +
+                (header->table_mb ? NodeTable::bytes_for(header->table_mb) : 0);
+        if (!valid) {
+            munmap(mapping, st.st_size);
+            continue;
+        }
+
+        m_header = header;
+        m_size = st.st_size;
+        m_n_processes = header->n_processes;
+        m_table_mb = header->table_mb;
+        m_table = m_table_mb ? static_cast<char*>(mapping) + table_offset(m_n_processes) : nullptr;
+        return;
+    }
+}
+
+SharedSearch::~SharedSearch() {
+    if (!m_header) {
+        return;
+    }
+    if (m_slot == 0) {
+        m_header->stop.store(1, std::memory_order_release);
+        shm_unlink(m_name.c_str());
+    }
+    munmap(m_header, m_size);
+}
+
+std::size_t SharedSearch::table_offset(int n_processes) {
+    // The node table starts on its own page
+    return (sizeof(Header) + n_processes * sizeof(Slot) + page_size - 1) / page_size * page_size;
+}
+
+SharedSearch::Slot& SharedSearch::slot_at(int slot) const {
+    auto* slots = reinterpret_cast<Slot*>(reinterpret_cast<char*>(m_header) + sizeof(Header));
+    return slots[slot];
+}
+
+uint64_t SharedSearch::start(const Board& board, SearchBudget budget) {
+    const uint64_t sequence = m_header->job_sequence.load(std::memory_order_relaxed);
+    m_header->job_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_header->white.store(board.bitboard(Piece::WHITE), std::memory_order_relaxed);
+    m_header->black.store(board.bitboard(Piece::BLACK), std::memory_order_relaxed);
+    m_header->ply.store(board.ply(), std::memory_order_relaxed);
+    m_header->ms.store(budget.ms, std::memory_order_relaxed);
+    m_header->iterations.store(budget.iterations, std::memory_order_relaxed);
+    m_header->nodes.store(budget.nodes, std::memory_order_relaxed);
+    const uint64_t generation = m_header->generation.load(std::memory_order_relaxed) + 1;
+    m_header->generation.store(generation, std::memory_order_relaxed);
+
+    m_header->job_sequence.store(sequence + 2, std::memory_order_release);
+    return generation;
+}
+
+bool SharedSearch::wait(int timeout_ms) const {
+    const uint64_t generation = m_header->generation.load(std::memory_order_acquire);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (int slot = 1; slot < m_n_processes; ++slot) {
+        while (slot_at(slot).generation.load(std::memory_order_acquire) != generation) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(poll_interval);
+        }
+    }
+    return true;
+}
+
+std::optional<SharedJob> SharedSearch::next_job(uint64_t last_generation) const {
+    while (!m_header->stop.load(std::memory_order_acquire) && process_alive(m_header->leader_pid)) {
+        // Read a consistent copy of the job
+        const uint64_t sequence = m_header->job_sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        const uint64_t generation = m_header->generation.load(std::memory_order_relaxed);
+        if (generation <= last_generation) {
+            std::this_thread::sleep_for(poll_interval);
+            continue;
+        }
+
+        SearchBudget budget;
+        const uint64_t white = m_header->white.load(std::memory_order_relaxed);
+        const uint64_t black = m_header->black.load(std::memory_order_relaxed);
+        const int ply = m_header->ply.load(std::memory_order_relaxed);
+        budget.ms = m_header->ms.load(std::memory_order_relaxed);
+        budget.iterations = m_header->iterations.load(std::memory_order_relaxed);
+        budget.nodes = m_header->nodes.load(std::memory_order_relaxed);
+
+        // The leader may have started writing the next job meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_header->job_sequence.load(std::memory_order_relaxed) == sequence) {
+            return SharedJob{generation, Board(white, black, ply), budget};
+        }
+    }
+    return std::nullopt;
+}
+
+void SharedSearch::publish(uint64_t generation, const std::vector<RootStats>& stats) {
+    Slot& slot = slot_at(m_slot);
+    const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const int n_moves = std::min<int>(stats.size(), max_moves);
+    slot.n_moves.store(n_moves, std::memory_order_relaxed);
+    for (int i = 0; i < n_moves; ++i) {
+        PackedStats packed{stats[i].visits, static_cast<float>(stats[i].value)};
+        slot.stats[i].store(std::bit_cast<uint64_t>(packed), std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    slot.generation.store(generation, std::memory_order_release);
+}
+
+std::vector<RootStats> SharedSearch::merged_stats(const Board& board) const {
+    MoveGen movegen;
+    const auto& moves = movegen.valid_moves(board);
+    std::vector<RootStats> merged;
+    for (const auto& move : moves) {
+        merged.push_back({move, 0, 0.0});
+    }
+
+    const uint64_t generation = m_header->generation.load(std::memory_order_acquire);
+    std::vector<PackedStats> stats(moves.size());
+    long most_visits = -1;
+    for (int s = 0; s < m_n_processes; ++s) {
+        const Slot& slot = slot_at(s);
+        if (slot.generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+
+        // Read a consistent copy of the slot
+        while (true) {
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            const bool complete = slot.n_moves.load(std::memory_order_relaxed) == moves.size();
+            for (std::size_t i = 0; complete && i < moves.size(); ++i) {
+                stats[i] = std::bit_cast<PackedStats>(slot.stats[i].load(std::memory_order_relaxed));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            if (!complete) {
+                stats.assign(moves.size(), PackedStats{0, 0.0f});
+            }
+            break;
+        }
+
+        if (m_table) {
+            long visits = 0;
+            for (const auto& packed : stats) {
+                visits += packed.visits;
+            }
+            if (visits > most_visits) {
+                most_visits = visits;
+                for (std::size_t i = 0; i < moves.size(); ++i) {
+                    merged[i].visits = stats[i].visits;
+                    merged[i].value = stats[i].value;
+                }
+            }
+            continue;
+        }
+
+        for (std::size_t i = 0; i < moves.size(); ++i) {
+            const int visits = merged[i].visits + stats[i].visits;
+            if (visits > 0) {
+                merged[i].value = (merged[i].value * merged[i].visits + double(stats[i].value) * stats[i].visits) / visits;
+            }
+            merged[i].visits = visits;
+        }
+    }
+    return merged;
+}
+
+Move SharedSearch::choose_best(const Board& board) const {
+    auto stats = merged_stats(board);
+    assert(not stats.empty() && "cannot choose best without valid moves");
+    auto best = std::max_element(stats.begin(), stats.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.visits < b.visits;
+                     });
+    return best->move;
+}
+
+}  // namespace breakthrough
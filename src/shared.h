@@ -0,0 +1,153 @@
+/**
+ * @file shared.h
+ *
+ * Several engine processes searching the same position together.
+ *
+ * The processes map one POSIX shared-memory segment. The leader (slot 0)
+ * creates it and publishes each position to search with its budget. The
+ * helpers (slots 1 to n-1) search it with their own MCTS and publish
+ * their root statistics, which the leader merges to choose its move.
+ * Optionally, the segment also holds a node table used by every process,
+ * in which case they all grow the same tree.
+ *
+ * Each process is meant to be pinned to a NUMA node, so that its memory
+ * and threads stay local to one socket.
+ */
+
+#ifndef SHARED_H_
+#define SHARED_H_
+
+#include "board.h"
+#include "mcts.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace breakthrough {
+
+/**
+ * The number of NUMA nodes of the machine, 1 if it does not report them.
+ */
+int numa_node_count();
+
+/**
+ * Run the calling thread, and the threads it creates from now on, on the
+ * CPUs of the given NUMA node.
+ *
+ * Returns false, leaving the affinity unchanged, if the machine does not
+ * report that node.
+ */
+bool pin_to_numa_node(int node);
+
+/**
+ * A position published by the leader.
+ */
+struct SharedJob {
+    uint64_t generation;
+    Board board;
+    SearchBudget budget;
+};
+
+class SharedSearch {
+public:
+    /**
+     * Open the segment of the given name, e.g. "/breakthrough", as one of
+     * `n_processes` processes.
+     *
+     * The leader creates the segment, replacing any segment left with
+     * that name, and a shared node table of `table_mb` megabytes if not 0.
+     * The helpers wait for it for a few seconds and take their parameters
+     * from it.
+     */
+    SharedSearch(const std::string& name, int n_processes, int slot, std::size_t table_mb = 0);
+
+    /**
+     * The leader stops the helpers and removes the segment.
+     */
+    ~SharedSearch();
+
+    SharedSearch(const SharedSearch&) = delete;
+    SharedSearch& operator=(const SharedSearch&) = delete;
+
+    /**
+     * Check if the segment could be opened.
+     */
+    explicit operator bool() const { return m_header != nullptr; }
+
+    int slot() const { return m_slot; }
+    int n_processes() const { return m_n_processes; }
+
+    /**
+     * The memory of the shared node table, to give to MCTS, or nullptr if
+     * the processes keep their own tables.
+     */
+    void* table_memory() const { return m_table; }
+
+    /**
+     * The size of the shared node table, 0 if there is none.
+     */
+    std::size_t table_mb() const { return m_table_mb; }
+
+    /**
+     * Leader: ask the helpers to search the position. Returns the
+     * generation of the job.
+     */
+    uint64_t start(const Board& board, SearchBudget budget);
+
+    /**
+     * Leader: wait until every helper has published its statistics for
+     * the last job. Returns false after the timeout.
+     */
+    bool wait(int timeout_ms) const;
+
+    /**
+     * Helper: wait for a job newer than the given generation. Returns
+     * nothing once the leader stops or exits.
+     */
+    std::optional<SharedJob> next_job(uint64_t last_generation) const;
+
+    /**
+     * Publish the root statistics of this process for the job of the
+     * given generation.
+     */
+    void publish(uint64_t generation, const std::vector<RootStats>& stats);
+
+    /**
+     * The statistics of the root moves, in MoveGen order, from every
+     * process that published them for the last job.
+     *
+     * With separate tables, the visits are summed. With a shared table,
+     * each process already sees the visits of the others and the most
+     * complete statistics are used.
+     */
+    std::vector<RootStats> merged_stats(const Board& board) const;
+
+    /**
+     * The most visited root move over all processes.
+     */
+    Move choose_best(const Board& board) const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    static std::size_t table_offset(int n_processes);
+
+    Slot& slot_at(int slot) const;
+
+    int m_slot;
+    int m_n_processes{0};
+    std::string m_name;
+
+    Header* m_header{nullptr};
+    std::size_t m_size{0};
+    void* m_table{nullptr};
+    std::size_t m_table_mb{0};
+};
+
+}  // namespace breakthrough
+
+#endif // SHARED_H_
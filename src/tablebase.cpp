@@ -0,0 +1,380 @@
+#include "tablebase.h"
+#include "movegen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace breakthrough {
+
+namespace {
+
+thread_local MoveGen movegen;
+
+/**
+ * Header of a table file, followed by `size` value bytes.
+ */
+struct FileHeader {
+    char magic[8];
+    uint32_t white;
+    uint32_t black;
+    uint64_t size;
+};
+
+constexpr char file_magic[8] = {'B', 'T', 'T', 'B', '1', '\0', '\0', '\0'};
+
+/**
+ * White pawns are never on the last rank with white to move, nor black
+ * pawns on the first one, so each color has 56 possible squares.
+ */
+constexpr int n_squares = 56;
+constexpr uint64_t first_rank = 0xFFull;
+constexpr uint64_t last_rank = 0xFFull << 56;
+
+constexpr auto binomials = [] {
+    std::array<std::array<uint64_t, Tablebase::max_side + 1>, n_squares + 1> c{};
+    for (int n = 0; n <= n_squares; ++n) {
+        c[n][0] = 1;
+        for (int k = 1; k <= Tablebase::max_side && k <= n; ++k) {
+            c[n][k] = c[n - 1][k - 1] + c[n - 1][k];
+        }
+    }
+    return c;
+}();
+
+/**
+ * The rank of a set of squares among the sets of the same size, in the
+ * combinatorial number system.
+ */
+uint64_t subset_rank(uint64_t set) {
+    uint64_t rank = 0;
+    for (int i = 1; set; ++i) {
+        rank += binomials[std::countr_zero(set)][i];
+        set &= set - 1;
+    }
+    return rank;
+}
+
+/**
+ * The set of `k` squares with the given rank.
+ */
+uint64_t subset_unrank(uint64_t rank, int k) {
+    uint64_t set = 0;
+    for (int i = k; i >= 1; --i) {
+        int s = i - 1;
+        while (s + 1 < n_squares && binomials[s + 1][i] <= rank) {
+            ++s;
+        }
+        rank -= binomials[s][i];
+        set |= 1ull << s;
+    }
+    return set;
+}
+
+uint64_t table_size(int white, int black) {
+    return binomials[n_squares][white] * binomials[n_squares][black];
+}
+
+uint64_t position_index(uint64_t white, uint64_t black, int n_black) {
+    return subset_rank(white) * binomials[n_squares][n_black] + subset_rank(black >> 8);
+}
+
+/**
+ * Wins are stored as their number of plies, from 1 to 127, and losses
+ * as 128 plus their number of plies, so that 0 is left for positions
+ * that are not covered.
+ */
+constexpr uint8_t loss_base = 128;
+
+uint8_t encode(bool win, int plies) {
+    assert(plies < loss_base && "distance does not fit in a value byte");
+    return win ? plies : loss_base + plies;
+}
+
+TablebaseValue decode(uint8_t value) {
+    return value < loss_base ? TablebaseValue{true, value} : TablebaseValue{false, value - loss_base};
+}
+
+/**
+ * The sum of the number of ranks each pawn has advanced. Every move
+ * increases it by one, and captures also decrease the number of pawns.
+ */
+int progress(uint64_t white, uint64_t black) {
+    int total = 0;
+    for (; white; white &= white - 1) {
+        total += std::countr_zero(white) / 8;
+    }
+    for (; black; black &= black - 1) {
+        total += 7 - std::countr_zero(black) / 8;
+    }
+    return total;
+}
+
+/**
+ * Call `f(i)` for every i in [0, n) on the given number of threads.
+ */
+template <typename F>
+void parallel_for(uint64_t n, int threads, F f) {
+    constexpr uint64_t chunk = 1 << 14;
+    std::atomic<uint64_t> next{0};
+    auto work = [&]() {
+        uint64_t begin;
+        while ((begin = next.fetch_add(chunk)) < n) {
+            const uint64_t end = std::min(n, begin + chunk);
+            for (uint64_t i = begin; i < end; ++i) {
+                f(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < threads; ++t) {
+        helpers.emplace_back(work);
+    }
+    work();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+}
+
+std::filesystem::path table_path(const std::string& directory, int white, int black) {
+    return std::filesystem::path(directory) / ("tb_" + std::to_string(white) + "v" + std::to_string(black) + ".bttb");
+}
+
+}  // namespace
+
+void Tablebase::Table::reset() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+    owned.clear();
+    owned.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+}
+
+Tablebase::~Tablebase() {
+    clear();
+}
+
+void Tablebase::clear() {
+    for (auto& row : m_tables) {
+        for (auto& table : row) {
+            table.reset();
+        }
+    }
+}
+
+uint8_t Tablebase::lookup(uint64_t white, uint64_t black) const {
+    const int n_white = std::popcount(white);
+    const int n_black = std::popcount(black);
+    if (n_white > max_side || n_black > max_side) {
+        return 0;
+    }
+    const Table& table = m_tables[n_white][n_black];
+    if (!table.data) {
+        return 0;
+    }
+    return table.data[position_index(white, black, n_black)];
+}
+
+std::optional<TablebaseValue> Tablebase::probe(const Board& board) const {
+    if (board.is_terminal()) {
+        return std::nullopt;
+    }
+    uint64_t white = board.bitboard(Piece::WHITE);
+    uint64_t black = board.bitboard(Piece::BLACK);
+
+    // Mirror the ranks and swap the colors to get white to move
+    if (board.ply() & 1) {
+        std::swap(white, black);
+        white = __builtin_bswap64(white);
+        black = __builtin_bswap64(black);
+    }
+    if ((white & last_rank) || (black & first_rank)) {
+        return std::nullopt;
+    }
+
+    const uint8_t value = lookup(white, black);
+    if (!value) {
+        return std::nullopt;
+    }
+    return decode(value);
+}
+
+void Tablebase::generate(int max_pieces, int threads) {
+    clear();
+    threads = std::max(threads, 1);
+
+    // Captures lead to fewer pawns, so smaller totals are solved first
+    for (int total = 2; total <= max_pieces; ++total) {
+        std::vector<std::pair<int, int>> materials;
+        for (int n_white = 1; n_white < total; ++n_white) {
+            const int n_black = total - n_white;
+            if (n_white > max_side || n_black > max_side) {
+                continue;
+            }
+            Table& table = m_tables[n_white][n_black];
+            table.size = table_size(n_white, n_black);
+            table.owned.assign(table.size, 0);
+            table.data = table.owned.data();
+            materials.emplace_back(n_white, n_black);
+        }
+
+        // Progress of each position, or UINT8_MAX if pawns overlap
+        std::vector<std::vector<uint8_t>> levels(materials.size());
+        for (std::size_t m = 0; m < materials.size(); ++m) {
+            const auto [n_white, n_black] = materials[m];
+            const uint64_t black_sets = binomials[n_squares][n_black];
+            levels[m].resize(m_tables[n_white][n_black].size);
+            parallel_for(levels[m].size(), threads, [&, n_white = n_white, n_black = n_black](uint64_t i) {
+                const uint64_t white = subset_unrank(i / black_sets, n_white);
+                const uint64_t black = subset_unrank(i % black_sets, n_black) << 8;
+                levels[m][i] = (white & black) ? UINT8_MAX : progress(white, black);
+            });
+        }
+
+        // Moves without captures increase the progress by one, so the most
+        // advanced positions are solved first
+        for (int level = 6 * total; level >= 0; --level) {
+            for (std::size_t m = 0; m < materials.size(); ++m) {
+                const auto [n_white, n_black] = materials[m];
+                const uint64_t black_sets = binomials[n_squares][n_black];
+                Table& table = m_tables[n_white][n_black];
+                parallel_for(table.size, threads, [&, n_white = n_white, n_black = n_black](uint64_t i) {
+                    if (levels[m][i] != level) {
+                        return;
+                    }
+                    Board board(subset_unrank(i / black_sets, n_white),
+                                subset_unrank(i % black_sets, n_black) << 8, 0);
+                    const auto& moves = movegen.valid_moves(board);
+
+                    // The side to move loses when it has no moves
+                    int quickest_win = INT_MAX;
+                    int longest_loss = 0;
+                    for (const auto& move : moves) {
+                        if (move.target >= 56) {
+                            quickest_win = 1;
+                            break;
+                        }
+                        const Piece captured = board.at(move.target);
+                        board.play(move);
+                        const uint64_t white = board.bitboard(Piece::WHITE);
+                        const uint64_t black = board.bitboard(Piece::BLACK);
+                        board.unmake(move, captured);
+                        if (!black) {
+                            quickest_win = 1;
+                            break;
+                        }
+
+                        const uint8_t value = lookup(__builtin_bswap64(black), __builtin_bswap64(white));
+                        assert(value && "successor solved after its predecessor");
+                        const TablebaseValue child = decode(value);
+                        if (child.win) {
+                            longest_loss = std::max(longest_loss, child.plies + 1);
+                        } else {
+                            quickest_win = std::min(quickest_win, child.plies + 1);
+                        }
+                    }
+                    table.owned[i] = quickest_win != INT_MAX ? encode(true, quickest_win)
+                                                             : encode(false, longest_loss);
+                });
+            }
+        }
+    }
+}
+
+bool Tablebase::save(const std::string& directory) const {
+    for (int n_white = 0; n_white <= max_side; ++n_white) {
+        for (int n_black = 0; n_black <= max_side; ++n_black) {
+            const Table& table = m_tables[n_white][n_black];
+            if (!table.data) {
+                continue;
+            }
+            std::ofstream out(table_path(directory, n_white, n_black), std::ios::binary);
+            FileHeader header{};
+            std::memcpy(header.magic, file_magic, sizeof(file_magic));
+            header.white = n_white;
+            header.black = n_black;
+            header.size = table.size;
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(table.data), table.size);
+            if (!out.good()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int Tablebase::load(const std::string& directory) {
+    int n_loaded = 0;
+    for (int n_white = 1; n_white <= max_side; ++n_white) {
+        for (int n_black = 1; n_black <= max_side; ++n_black) {
+            const std::string path = table_path(directory, n_white, n_black);
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                continue;
+            }
+            struct stat st;
+            const uint64_t size = table_size(n_white, n_black);
+            const std::size_t expected_size = sizeof(FileHeader) + size;
+            if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != expected_size) {
+                close(fd);
+                continue;
+            }
+            void* mapping = mmap(nullptr, expected_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                continue;
+            }
+
+            const auto* header = static_cast<const FileHeader*>(mapping);
+            if (std::memcmp(header->magic, file_magic, sizeof(file_magic)) != 0 ||
+                header->white != static_cast<uint32_t>(n_white) ||
+                header->black != static_cast<uint32_t>(n_black) || header->size != size) {
+                munmap(mapping, expected_size);
+                continue;
+            }
+
+            Table& table = m_tables[n_white][n_black];
+            table.reset();
+            table.mapping = mapping;
+            table.mapping_size = expected_size;
+            table.data = reinterpret_cast<const uint8_t*>(header + 1);
+            table.size = size;
+            ++n_loaded;
+        }
+    }
+    return n_loaded;
+}
+
+int Tablebase::max_pieces() const {
+    int covered = 0;
+    for (int total = 2; total <= 2 * max_side; ++total) {
+        for (int n_white = std::max(1, total - max_side); n_white <= std::min(max_side, total - 1); ++n_white) {
+            if (!m_tables[n_white][total - n_white].data) {
+                return covered;
+            }
+        }
+        covered = total;
+    }
+    return covered;
+}
+
+}  // namespace breakthrough
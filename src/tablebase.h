@@ -0,0 +1,124 @@
+/**
+ * @file tablebase.h
+ *
+ * Endgame tablebases: the exact value of every position with few pawns.
+ *
+ * Pawns only move forward and captures only remove pawns, so no position
+ * can be reached twice and the positions of an endgame form a DAG. The
+ * generator solves it backwards, from the positions with the fewest
+ * pawns and, for a given number of pawns, from the most advanced ones,
+ * so that the successors of a position are always solved before it.
+ *
+ * Positions are stored with white to move, a position with black to move
+ * being looked up as its mirror image with the colors swapped. There is
+ * one table per material, of one byte per position, indexed by the
+ * combinatorial rank of the white and black pawn sets.
+ */
+
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+
+#include "board.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace breakthrough {
+
+/**
+ * The exact value of a position for its side to move.
+ */
+struct TablebaseValue {
+    bool win;
+
+    /**
+     * The number of plies until the game ends, the winner playing the
+     * quickest win and the loser the longest defence.
+     */
+    int plies;
+};
+
+class Tablebase {
+public:
+    /**
+     * The largest number of pawns of one color in a table.
+     */
+    static constexpr int max_side = max_pawns;
+
+    Tablebase() = default;
+    ~Tablebase();
+
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    /**
+     * Solve every position with at most `max_pieces` pawns in total on
+     * the given number of threads.
+     *
+     * Replaces the tables that were loaded or generated before.
+     */
+    void generate(int max_pieces, int threads = 1);
+
+    /**
+     * Write the tables to the directory, one file per material.
+     */
+    bool save(const std::string& directory) const;
+
+    /**
+     * Memory-map the tables written by `save` in the directory.
+     *
+     * Malformed files are skipped. Returns the number of tables loaded.
+     */
+    int load(const std::string& directory);
+
+    /**
+     * The largest number of pawns up to which every material is covered.
+     */
+    int max_pieces() const;
+
+    /**
+     * The exact value of the position, if its material is covered and
+     * the game is not over.
+     */
+    std::optional<TablebaseValue> probe(const Board& board) const;
+
+private:
+    /**
+     * The positions of one material with white to move.
+     */
+    struct Table {
+        /**
+         * Points either to `owned` or to the memory-mapped file.
+         */
+        const uint8_t* data{nullptr};
+        uint64_t size{0};
+
+        std::vector<uint8_t> owned;
+
+        void* mapping{nullptr};
+        std::size_t mapping_size{0};
+
+        void reset();
+    };
+
+    /**
+     * The value byte of a position with white to move, 0 if its material
+     * is not covered.
+     */
+    uint8_t lookup(uint64_t white, uint64_t black) const;
+
+    void clear();
+
+    /**
+     * Indexed by the number of white and black pawns.
+     */
+    std::array<std::array<Table, max_side + 1>, max_side + 1> m_tables;
+};
+
+}  // namespace breakthrough
+
+#endif // TABLEBASE_H_
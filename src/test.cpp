@@ -1,7 +1,33 @@
 #include "catch2/catch_test_macros.hpp"
+#include "arena.h"
 #include "board.h"
+#include "evaluator.h"
+#include "mcts.h"
 #include "movegen.h"
+#include "nnue.h"
+#include "pattern.h"
+#include "perf.h"
+#include "record.h"
+#include "server.h"
+#include "shared.h"
+#include "tablebase.h"
+#include "thread_pool.h"
+#include "ttable.h"
+#include "ucb.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
 
 using namespace breakthrough;
 
@@ -67,6 +93,56 @@ TEST_CASE("Board outputs correct fen strings", "[board]") {
     }
 }
 
+TEST_CASE("Board bitboards", "[board]") {
+    Board board;
+    REQUIRE(board.bitboard(Piece::WHITE) == 0xFFFFull);
+    REQUIRE(board.bitboard(Piece::BLACK) == 0xFFFFull << 48);
+
+    SECTION("Bitboards follow captures") {
+        board.play(Move{11, 19});
+        board.play(Move{52, 44});
+        board.play(Move{19, 27});
+        board.play(Move{44, 36});
+        board.play(Move{27, 36});
+        REQUIRE(board.bitboard(Piece::WHITE) == ((0xFFFFull & ~(1ull << 11)) | (1ull << 36)));
+        REQUIRE(board.bitboard(Piece::BLACK) == ((0xFFFFull << 48) & ~(1ull << 52)));
+    }
+
+    SECTION("A board rebuilt from its bitboards is the same position") {
+        board.play(Move{11, 19});
+        Board copy(board.bitboard(Piece::WHITE), board.bitboard(Piece::BLACK), board.ply());
+        REQUIRE(copy.squares() == board.squares());
+        REQUIRE(copy.hash() == board.hash());
+        REQUIRE(copy.fen() == board.fen());
+    }
+
+    SECTION("Boards with more pawns than a side can have are rejected") {
+        REQUIRE_THROWS_AS(Board(0x1FFFFull, 0xFFFFull << 48, 0), std::invalid_argument);
+        std::istringstream fen("pppppppp/pppppppp/p7/8/8/8/PPPPPPPP/PPPPPPPP w - - 0 1");
+        REQUIRE_THROWS_AS(Board(fen), std::invalid_argument);
+        std::istringstream too_long("8/8/8/8/8/8/8/8/PPPP w - - 0 1");
+        REQUIRE_THROWS_AS(Board(too_long), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Board unmake restores the position", "[board]") {
+    Board board;
+    const Board initial = board;
+    std::vector<std::pair<Move, Piece>> history;
+    for (Move move : {Move{11, 19}, Move{52, 44}, Move{19, 27}, Move{44, 36}, Move{27, 36}}) {
+        history.emplace_back(move, board.at(move.target));
+        board.play(move);
+    }
+    for (auto it = history.rbegin(); it != history.rend(); ++it) {
+        board.unmake(it->first, it->second);
+    }
+    REQUIRE(board.squares() == initial.squares());
+    REQUIRE(board.hash() == initial.hash());
+    REQUIRE(board.ply() == initial.ply());
+    REQUIRE(board.bitboard(Piece::WHITE) == initial.bitboard(Piece::WHITE));
+    REQUIRE(board.bitboard(Piece::BLACK) == initial.bitboard(Piece::BLACK));
+}
+
 TEST_CASE("MoveGen functionality", "[movegen]") {
     Board board{};
     MoveGen movegen;
@@ -114,3 +190,945 @@ TEST_CASE("Move printing", "[move]") {
     REQUIRE(ss1.str() == "d2e3");
     REQUIRE(ss2.str() == "a7a6");
 }
+
+TEST_CASE("Pattern codes", "[pattern]") {
+    Board board;
+
+    SECTION("Codes are in range and distinguish directions") {
+        int straight = pattern_code(board, Move{11, 19});
+        int left = pattern_code(board, Move{11, 18});
+        int right = pattern_code(board, Move{11, 20});
+        for (int code : {straight, left, right}) {
+            REQUIRE(code >= 0);
+            REQUIRE(code < n_patterns);
+        }
+        REQUIRE(straight != left);
+        REQUIRE(straight != right);
+        REQUIRE(left != right);
+    }
+
+    SECTION("Codes are relative to the side to move") {
+        int white_code = pattern_code(board, Move{11, 19});
+        board.play(Move{8, 16});
+        int black_code = pattern_code(board, Move{52, 44});
+        REQUIRE(white_code == black_code);
+    }
+}
+
+TEST_CASE("Pattern table", "[pattern]") {
+    PatternTable table;
+    table.set_weight(42, 3.5f);
+    REQUIRE(table.weight(0) == 1.0f);
+    REQUIRE(table.weight(42) == 3.5f);
+
+    const std::string path = "pattern_table_test.bin";
+    REQUIRE(table.save(path));
+
+    PatternTable loaded;
+    REQUIRE(loaded.load(path));
+    REQUIRE(loaded.weight(42) == 3.5f);
+    REQUIRE_FALSE(loaded.load("missing_pattern_table.bin"));
+    std::remove(path.c_str());
+
+    SECTION("Sampling only returns moves with positive weight") {
+        Board board;
+        MoveGen movegen;
+        const auto& moves = movegen.valid_moves(board);
+        PatternTable only_one;
+        for (int code = 0; code < n_patterns; ++code) {
+            only_one.set_weight(code, 0.0f);
+        }
+        only_one.set_weight(pattern_code(board, moves[3]), 1.0f);
+        std::mt19937 gen(0);
+        for (int i = 0; i < 10; ++i) {
+            Move move = only_one.sample(board, moves, gen);
+            REQUIRE(move.source == moves[3].source);
+            REQUIRE(move.target == moves[3].target);
+        }
+    }
+}
+
+TEST_CASE("Position records", "[record]") {
+    Board board;
+    board.play(Move{11, 19});
+
+    auto record = make_record(board, {3, 1, 0, 0});
+    REQUIRE(record.n_moves == 4);
+    REQUIRE(record.total_visits == 4);
+    REQUIRE(record.visits[0] + record.visits[1] == 65535);
+    REQUIRE(record.board().hash() == board.hash());
+    REQUIRE(record.board().ply() == 1);
+
+    const std::string path = "records_test.bin";
+    std::remove(path.c_str());
+    {
+        RecordWriter writer(path);
+        REQUIRE(writer);
+        writer.write({record, make_record(Board{}, {1})});
+    }
+
+    RecordFile records(path);
+    REQUIRE(records);
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0].white == record.white);
+    REQUIRE(records[0].policy(0) == record.policy(0));
+    REQUIRE(records[1].board().hash() == Board{}.hash());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("NNUE accumulator is updated incrementally", "[nnue]") {
+    Network network;
+    network.randomize(42);
+
+    Board board;
+    board.set_network(&network);
+
+    auto same_as_refresh = [&](const Board& b) {
+        Accumulator fresh;
+        network.refresh(b.squares(), fresh);
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < nnue_hidden; ++i) {
+                if (fresh.values[p][i] != b.accumulator().values[p][i]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    std::vector<std::pair<Move, Piece>> history;
+    for (Move move : {Move{11, 19}, Move{52, 44}, Move{19, 27}, Move{44, 36}, Move{27, 36}}) {
+        history.emplace_back(move, board.at(move.target));
+        board.play(move);
+        REQUIRE(same_as_refresh(board));
+    }
+    for (auto it = history.rbegin(); it != history.rend(); ++it) {
+        board.unmake(it->first, it->second);
+        REQUIRE(same_as_refresh(board));
+    }
+
+    SECTION("Evaluation does not depend on how the accumulator was obtained") {
+        Board plain;
+        plain.set_network(nullptr);
+        REQUIRE(network.score(plain) == network.score(board));
+        double value = network.evaluate(board);
+        REQUIRE(value >= -1.0);
+        REQUIRE(value <= 1.0);
+    }
+
+    SECTION("Each evaluator sets up its own network, copies their own accumulator") {
+        REQUIRE(Board().network() == nullptr);
+
+        Network other;
+        other.randomize(7);
+        NnueEvaluator first(network);
+        NnueEvaluator second(other);
+        Board root;
+        Board other_root;
+        first.prepare(root);
+        second.prepare(other_root);
+        REQUIRE(root.network() == &network);
+        REQUIRE(other_root.network() == &other);
+
+        Board copy = root;
+        copy.play(Move{11, 19});
+        REQUIRE(same_as_refresh(root));
+        REQUIRE(same_as_refresh(copy));
+        copy = Board();
+        REQUIRE(copy.network() == nullptr);
+
+        // Taking only the position keeps the network of the destination
+        root.play(Move{11, 19});
+        Board plain;
+        plain.set_position(root);
+        REQUIRE(plain.network() == nullptr);
+        REQUIRE(plain.hash() == root.hash());
+        other_root.set_position(root);
+        REQUIRE(other_root.network() == &other);
+        Board fresh = plain;
+        fresh.set_network(&other);
+        REQUIRE(other.score(other_root) == other.score(fresh));
+    }
+
+    SECTION("Weights round-trip through a stream") {
+        std::stringstream buffer;
+        REQUIRE(network.save(buffer));
+        Network loaded;
+        REQUIRE(loaded.load(buffer));
+        REQUIRE(loaded.score(board) == network.score(board));
+
+        std::stringstream garbage("not a network");
+        REQUIRE_FALSE(loaded.load(garbage));
+    }
+}
+
+TEST_CASE("Evaluators", "[evaluator]") {
+    std::vector<Board> leaves(2);
+    leaves[1].play(Move{11, 19});
+    std::vector<double> values(2);
+
+    SECTION("Rollouts") {
+        RolloutEvaluator rollouts(2, SearchConfig{}.discount);
+        rollouts.evaluate(leaves, values);
+        for (double value : values) {
+            REQUIRE(value >= -1.0);
+            REQUIRE(value <= 1.0);
+        }
+    }
+
+    SECTION("Undiscounted rollouts count wins and losses") {
+        RolloutEvaluator rollouts(1, 1.0);
+        rollouts.evaluate(leaves, values);
+        for (std::size_t i = 0; i < leaves.size(); ++i) {
+            // One rollout of +-1 from each child of the leaf
+            double n_children = MoveGen().valid_moves(leaves[i]).size();
+            double wins_minus_losses = values[i] * n_children;
+            REQUIRE(std::abs(wins_minus_losses - std::round(wins_minus_losses)) < 1e-9);
+        }
+    }
+
+    SECTION("Static evaluation is symmetric in the initial position") {
+        StaticEvaluator evaluator;
+        evaluator.evaluate(leaves, values);
+        REQUIRE(values[0] == 0.0);
+        REQUIRE(values[1] < 0.0);
+    }
+}
+
+TEST_CASE("MCTS finds a winning move with batched evaluation", "[mcts]") {
+    // White to move with a pawn on e7, black far from promotion
+    Board board((1ull << 52) | (1ull << 8), (1ull << 63) | (1ull << 56), 0);
+
+    SearchConfig config;
+    config.batch_size = 4;
+    config.exploration = 0.7;
+    MCTS mcts(config);
+    StaticEvaluator evaluator;
+    mcts.set_evaluator(&evaluator);
+
+    mcts.ponder(board, 50);
+    Move move = mcts.choose_best(board);
+    REQUIRE(move.source == 52);
+    REQUIRE(move.target >= 56);
+}
+
+TEST_CASE("Thread pool runs every task", "[server]") {
+    std::atomic<int> count{0};
+    std::atomic<int> nested{0};
+    {
+        ThreadPool pool(3);
+        for (int i = 0; i < 100; ++i) {
+            pool.submit([&, i]() {
+                ++count;
+                // Tasks may queue more tasks
+                if (i % 10 == 0) {
+                    pool.submit([&]() { ++nested; });
+                }
+            });
+        }
+    }
+    REQUIRE(count == 100);
+    REQUIRE(nested == 10);
+}
+
+TEST_CASE("Server plays concurrent games", "[server]") {
+    ThreadPool pool(2);
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    Server server(pool, [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.push_back(line);
+    });
+
+    server.handle("new a");
+    server.handle("new b");
+    server.handle("play a d2d3");
+    server.handle("play b d2d5");
+    server.handle("go a 20");
+    server.handle("go b 20");
+    server.handle("play a a7a6");
+    server.wait();
+    server.handle("close b");
+    server.handle("play b a7a6");
+
+    auto count = [&](const std::string& prefix) {
+        return std::count_if(replies.begin(), replies.end(), [&](const std::string& r) {
+            return r.rfind(prefix, 0) == 0;
+        });
+    };
+    REQUIRE(count("ok a") == 2);
+    REQUIRE(count("ok b") == 2);
+    REQUIRE(count("error b invalid move") == 1);
+    REQUIRE(count("error a busy") == 1);
+    REQUIRE(count("bestmove a ") == 1);
+    REQUIRE(count("bestmove b ") == 1);
+    REQUIRE(count("error b unknown session") == 1);
+
+    // Closing a session stops its search long before the deadline
+    server.handle("new c");
+    server.handle("go c 60000");
+    server.handle("close c");
+    auto start = std::chrono::steady_clock::now();
+    server.wait();
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    REQUIRE(count("bestmove c ") == 0);
+}
+
+TEST_CASE("Server replies at once to searches past their deadline", "[server]") {
+    using namespace std::chrono;
+    ThreadPool pool(1);
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    steady_clock::time_point last_late_reply;
+    Server server(pool, [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.push_back(line);
+        if (line.rfind("bestmove 0 ", 0) != 0) {
+            last_late_reply = steady_clock::now();
+        }
+    }, SearchConfig{.table_mb = 1});
+
+    // Keep the only worker busy until every deadline but the first has passed
+    std::atomic<bool> release{false};
+    pool.submit([&]() {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    const int n_sessions = 100;
+    for (int i = 0; i < n_sessions; ++i) {
+        server.handle("new " + std::to_string(i));
+    }
+    for (int i = 0; i < n_sessions; ++i) {
+        server.handle("go " + std::to_string(i) + " " + (i == 0 ? "100" : "1"));
+    }
+    std::this_thread::sleep_for(milliseconds(5));
+    auto start = steady_clock::now();
+    release = true;
+    server.wait();
+
+    // The late sessions go first and do not search: at least 1 ms more for
+    // each would take over 100 ms
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(replies.size() == 2 * n_sessions);
+    REQUIRE(replies.back().rfind("bestmove 0 ", 0) == 0);
+    REQUIRE(last_late_reply - start < milliseconds(50));
+}
+
+TEST_CASE("Transposition table", "[ttable]") {
+    NodeTable table(1);
+    auto add_visit = [](NodeStats stats) {
+        ++stats.visits;
+        return stats;
+    };
+
+    SECTION("The table takes exactly the memory asked for") {
+        REQUIRE(NodeTable::bytes_for(16) == (16u << 20));
+        REQUIRE(table.capacity() == ((1u << 20) / 64 - 1) * NodeTable::bucket_size);
+    }
+
+    SECTION("Missing keys have default values") {
+        REQUIRE(table.probe(1234).visits == 0);
+    }
+
+    SECTION("Updates are found by later probes") {
+        table.update(1234, add_visit);
+        table.update(1234, add_visit);
+        REQUIRE(table.probe(1234).visits == 2);
+        REQUIRE(table.probe(4321).visits == 0);
+        table.clear();
+        REQUIRE(table.probe(1234).visits == 0);
+    }
+
+    SECTION("Keys sharing a bucket are told apart and the least visited is replaced") {
+        // The header takes the place of one bucket
+        const uint64_t stride = table.capacity() / NodeTable::bucket_size + 1;
+        for (uint64_t i = 1; i <= NodeTable::bucket_size; ++i) {
+            for (uint64_t v = 0; v < i + 1; ++v) {
+                table.update(i * stride + 7, add_visit);
+            }
+        }
+        for (uint64_t i = 1; i <= NodeTable::bucket_size; ++i) {
+            REQUIRE(table.probe(i * stride + 7).visits == int(i + 1));
+        }
+        table.update(100 * stride + 7, add_visit);
+        REQUIRE(table.probe(100 * stride + 7).visits == 1);
+        REQUIRE(table.probe(1 * stride + 7).visits == 0);
+        REQUIRE(table.probe(2 * stride + 7).visits == 3);
+    }
+
+    SECTION("Clearing forgets every key, over many generations") {
+        for (int i = 0; i < 600; ++i) {
+            table.update(1234, add_visit);
+            table.update(1234 + i, add_visit);
+            REQUIRE(table.probe(1234).visits == (i == 0 ? 2 : 1));
+            table.clear();
+            REQUIRE(table.probe(1234).visits == 0);
+            REQUIRE(table.probe(1234 + i).visits == 0);
+        }
+    }
+
+    SECTION("Updating only present keys does not insert them") {
+        REQUIRE(!table.update_if_present(1234, add_visit));
+        REQUIRE(table.probe(1234).visits == 0);
+        table.update(1234, add_visit);
+        REQUIRE(table.update_if_present(1234, add_visit));
+        REQUIRE(table.probe(1234).visits == 2);
+    }
+
+    SECTION("Updates racing with replacements stay on their own key") {
+        // More keys than a bucket holds, each marking its value with itself
+        const uint64_t stride = table.capacity() / NodeTable::bucket_size + 1;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < 20000; ++i) {
+                    const int id = 1 + (i * 7 + t) % (2 * NodeTable::bucket_size);
+                    table.update(id * stride + 7, [id](NodeStats stats) {
+                        ++stats.visits;
+                        stats.reward = static_cast<float>(id);
+                        return stats;
+                    });
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (int id = 1; id <= 2 * NodeTable::bucket_size; ++id) {
+            const NodeStats stats = table.probe(id * stride + 7);
+            REQUIRE((stats.visits == 0 || stats.reward == static_cast<float>(id)));
+        }
+    }
+
+    SECTION("Entries left busy by a killed process do not block the table") {
+        // One bucket and the header; keys hold the first word of each entry
+        alignas(64) uint64_t memory[16] = {};
+        NodeTable shared(memory, sizeof(memory), true);
+        memory[0] = 1;
+        memory[4] = 1;
+        for (uint64_t hash = 2; hash < 8; hash += 2) {
+            shared.update(hash, add_visit);
+        }
+        REQUIRE(shared.probe(6).visits == 1);
+
+        memory[2] = memory[6] = 1;
+        shared.update(8, add_visit);
+        REQUIRE(shared.probe(8).visits == 0);
+    }
+
+    SECTION("Concurrent updates are not lost") {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 1000; ++i) {
+                    table.update(42 + (i % 8), add_visit);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        int total = 0;
+        for (int i = 0; i < 8; ++i) {
+            total += table.probe(42 + i).visits;
+        }
+        REQUIRE(total == 4000);
+    }
+}
+
+TEST_CASE("Memory arena", "[arena]") {
+    MemoryArena arena(3 << 20);
+    REQUIRE(arena.data() != nullptr);
+    REQUIRE(arena.size() >= (3u << 20));
+    REQUIRE(reinterpret_cast<uintptr_t>(arena.data()) % (2 << 20) == 0);
+
+    // Fresh pages are zeroed and writable
+    auto* bytes = static_cast<unsigned char*>(arena.data());
+    REQUIRE(bytes[0] == 0);
+    REQUIRE(bytes[arena.size() - 1] == 0);
+    bytes[arena.size() - 1] = 42;
+
+    MemoryArena moved = std::move(arena);
+    REQUIRE(arena.data() == nullptr);
+    REQUIRE(static_cast<unsigned char*>(moved.data())[moved.size() - 1] == 42);
+
+    // Placement is only a request, the memory is usable either way
+    MemoryArena interleaved(1 << 20, NumaPlacement::Interleaved);
+    REQUIRE(interleaved.size() == (2u << 20));
+    static_cast<unsigned char*>(interleaved.data())[0] = 1;
+}
+
+TEST_CASE("UCB1 selection", "[mcts]") {
+    auto make_children = [](const std::vector<std::pair<float, float>>& stats) {
+        ChildStats children;
+        for (int i = 0; i < int(stats.size()); ++i) {
+            children.visits[i] = stats[i].first;
+            children.rewards[i] = stats[i].second;
+        }
+        for (int i = stats.size(); i % 8 != 0; ++i) {
+            children.visits[i] = 1.0f;
+            children.rewards[i] = -std::numeric_limits<float>::infinity();
+        }
+        return children;
+    };
+
+    // Both kernels must agree on every input, down to which of tied children wins
+    auto select = [](const ChildStats& children, int n_children, float log_parent_visits, float C) {
+        int best = argmax_ucb1_scalar(children, n_children, log_parent_visits, C);
+#if defined(__AVX2__)
+        REQUIRE(argmax_ucb1_avx2(children, n_children, log_parent_visits, C) == best);
+#endif
+        REQUIRE(argmax_ucb1(children, n_children, log_parent_visits, C) == best);
+        return best;
+    };
+
+    SECTION("The best child wins") {
+        auto children = make_children({{10, 2}, {10, 6}, {10, 4}});
+        REQUIRE(select(children, 3, std::log(30.0f), 0.0f) == 1);
+    }
+
+    SECTION("Padding lanes are never selected") {
+        // Every real child looks bad, and the padding lanes of the block follow them
+        for (int n = 1; n <= 9; ++n) {
+            std::vector<std::pair<float, float>> stats(n, {100.0f, -100.0f});
+            stats[n - 1] = {100.0f, -99.0f};
+            REQUIRE(select(make_children(stats), n, std::log(100.0f * n), 0.1f) == n - 1);
+        }
+    }
+
+    SECTION("Unvisited children come first") {
+        std::vector<std::pair<float, float>> stats(max_moves, {1.0f, 1.0f});
+        stats[13] = {0.0f, 0.0f};
+        stats[40] = {0.0f, 0.0f};
+        REQUIRE(select(make_children(stats), max_moves, std::log(float(max_moves)), 1.4f) == 13);
+    }
+
+    SECTION("Ties go to the first child") {
+        for (int first : {0, 7, 8, 21, max_moves - 1}) {
+            std::vector<std::pair<float, float>> stats(max_moves, {4.0f, 1.0f});
+            for (int i = first; i < max_moves; i += 5) {
+                stats[i] = {4.0f, 3.0f};
+            }
+            REQUIRE(select(make_children(stats), max_moves, std::log(4.0f * max_moves), 1.0f) == first);
+        }
+    }
+
+    SECTION("Random children") {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> n_dist(1, max_moves);
+        std::uniform_int_distribution<int> visits_dist(0, 50);
+        std::uniform_real_distribution<float> reward_dist(-1.0f, 1.0f);
+        for (int trial = 0; trial < 10000; ++trial) {
+            const int n = n_dist(rng);
+            std::vector<std::pair<float, float>> stats(n);
+            float parent_visits = 1.0f;
+            for (auto& [visits, reward] : stats) {
+                // Few distinct values, so that ties between children are common
+                visits = float(visits_dist(rng) / 10);
+                reward = visits * std::round(4.0f * reward_dist(rng)) / 4.0f;
+                parent_visits += visits;
+            }
+            select(make_children(stats), n, std::log(parent_visits), 1.4f);
+        }
+    }
+}
+
+TEST_CASE("Multi-threaded MCTS finds a winning move", "[mcts]") {
+    Board board((1ull << 52) | (1ull << 8), (1ull << 63) | (1ull << 56), 0);
+
+    SearchConfig config;
+    config.threads = 3;
+    config.batch_size = 2;
+    MCTS mcts(config);
+    StaticEvaluator evaluator;
+    mcts.set_evaluator(&evaluator);
+
+    mcts.ponder(board, 50);
+    Move move = mcts.choose_best(board);
+    REQUIRE(move.source == 52);
+    REQUIRE(move.target >= 56);
+}
+
+TEST_CASE("Budgeted search with a fixed seed is reproducible", "[mcts]") {
+    Board board;
+    board.play(Move{11, 19});
+
+    SearchConfig config;
+    config.seed = 1234;
+    SearchBudget budget;
+    budget.iterations = 100;
+
+    auto search = [&](SearchConfig c, SearchBudget b) {
+        MCTS mcts(c);
+        RolloutEvaluator rollouts(1, c.discount);
+        mcts.set_evaluator(&rollouts);
+        SearchInfo info = mcts.ponder(board, b);
+        REQUIRE(info.iterations <= 100);
+        std::vector<int> visits;
+        for (const auto& stats : mcts.root_stats(board)) {
+            visits.push_back(stats.visits);
+        }
+        return std::make_pair(visits, info);
+    };
+
+    auto [first, first_info] = search(config, budget);
+    auto [second, second_info] = search(config, budget);
+    REQUIRE(first_info.iterations == 100);
+    REQUIRE(first == second);
+    REQUIRE(first_info.nodes == second_info.nodes);
+
+    SECTION("Node budgets stop the search") {
+        SearchBudget nodes_budget;
+        nodes_budget.nodes = 50;
+        auto [visits, info] = search(config, nodes_budget);
+        REQUIRE(info.nodes >= 50);
+        REQUIRE(info.iterations < 50);
+    }
+}
+
+TEST_CASE("Per-phase performance report", "[perf]") {
+    perf::Report report;
+    report.phases[static_cast<int>(perf::Phase::Select)].calls = 3;
+    report.hardware = false;
+
+    std::ostringstream out;
+    report.print(out);
+    REQUIRE(out.str().find("select") != std::string::npos);
+    REQUIRE(out.str().find("backpropagate") != std::string::npos);
+    REQUIRE(out.str().find("IPC") == std::string::npos);
+
+#ifdef BREAKTHROUGH_PERF
+    SECTION("Scopes count their calls on the calling thread") {
+        perf::Report collected;
+        for (int i = 0; i < 4; ++i) {
+            PERF_SCOPE(perf::Phase::Evaluate);
+        }
+        perf::collect(collected);
+        REQUIRE(collected.phases[static_cast<int>(perf::Phase::Evaluate)].calls == 4);
+        REQUIRE(collected.phases[static_cast<int>(perf::Phase::Select)].calls == 0);
+    }
+
+    SECTION("A search prints its totals once, over every root round") {
+        SearchConfig config;
+        config.root_policy = RootPolicy::SequentialHalving;
+        MCTS mcts(config);
+        StaticEvaluator evaluator;
+        mcts.set_evaluator(&evaluator);
+
+        std::ostringstream printed;
+        mcts.set_perf_output(&printed);
+        mcts.ponder(Board(), SearchBudget{0, 500});
+        const std::string text = printed.str();
+        REQUIRE(text.find("phase") != std::string::npos);
+        REQUIRE(text.find("phase", text.find("phase") + 1) == std::string::npos);
+
+        mcts.set_perf_output(nullptr);
+        mcts.ponder(Board(), SearchBudget{0, 100});
+        mcts.ponder(Board(), SearchBudget{0, 100});
+        REQUIRE(mcts.take_perf_report().phases[static_cast<int>(perf::Phase::Evaluate)].calls == 200);
+    }
+#endif
+}
+
+TEST_CASE("Endgame tablebase", "[tablebase]") {
+    Tablebase tablebase;
+    tablebase.generate(3, 2);
+    REQUIRE(tablebase.max_pieces() == 3);
+
+    // A race between pawns on a2 and h7, won by the side to move
+    const uint64_t white = 1ull << 8;
+    const uint64_t black = 1ull << 55;
+    auto white_to_move = tablebase.probe(Board(white, black, 0));
+    REQUIRE(white_to_move);
+    REQUIRE(white_to_move->win);
+    REQUIRE(white_to_move->plies == 11);
+    auto black_to_move = tablebase.probe(Board(white, black, 1));
+    REQUIRE(black_to_move);
+    REQUIRE(black_to_move->win);
+    REQUIRE(black_to_move->plies == 11);
+
+    REQUIRE_FALSE(tablebase.probe(Board()));
+    REQUIRE_FALSE(tablebase.probe(Board(white | (1ull << 9), black | (1ull << 54), 0)));
+
+    SECTION("Values agree with the values of the children") {
+        std::mt19937 gen(7);
+        MoveGen movegen;
+        for (int i = 0; i < 200; ++i) {
+            const uint64_t w = (1ull << (gen() % 48 + 8)) | (gen() % 2 ? 1ull << (gen() % 56) : 0);
+            const uint64_t b = (1ull << (gen() % 56 + 8)) & ~w;
+            if (!b) {
+                continue;
+            }
+            Board board(w, b, gen() % 2);
+            auto value = tablebase.probe(board);
+            if (!value) {
+                continue;
+            }
+
+            bool win = false;
+            for (const auto& move : movegen.valid_moves(board)) {
+                Board child = board;
+                child.play(move);
+                auto child_value = tablebase.probe(child);
+                win |= child_value ? !child_value->win : true;
+            }
+            REQUIRE(value->win == win);
+            REQUIRE((value->plies % 2 == 1) == value->win);
+        }
+    }
+
+    SECTION("Tables are saved and memory-mapped") {
+        const auto directory = std::filesystem::temp_directory_path() / "breakthrough_tablebase_test";
+        std::filesystem::create_directories(directory);
+        REQUIRE(tablebase.save(directory.string()));
+
+        Tablebase loaded;
+        REQUIRE(loaded.load(directory.string()) == 3);
+        REQUIRE(loaded.max_pieces() == 3);
+        auto value = loaded.probe(Board(white, black, 0));
+        REQUIRE(value);
+        REQUIRE(value->plies == white_to_move->plies);
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("The search plays a winning move") {
+        // White to move wins with a2, b2 against h7 by running
+        Board board(white | (1ull << 9), black, 0);
+        MCTS mcts;
+        mcts.set_tablebase(&tablebase);
+        mcts.ponder(board, 20);
+        Board child = board;
+        child.play(mcts.choose_best(board));
+        auto value = tablebase.probe(child);
+        REQUIRE(value);
+        REQUIRE_FALSE(value->win);
+    }
+}
+
+TEST_CASE("Shared search across processes", "[shared]") {
+    // Two mappings of the segment behave like two processes
+    const std::string name = "/breakthrough_test_" + std::to_string(getpid());
+    Board board;
+    board.play(Move{11, 19});
+
+    SECTION("Root statistics are summed") {
+        SharedSearch leader(name, 2, 0);
+        REQUIRE(leader);
+        SharedSearch helper(name, 2, 1);
+        REQUIRE(helper);
+        REQUIRE(helper.n_processes() == 2);
+        REQUIRE(helper.table_memory() == nullptr);
+
+        SearchBudget budget;
+        budget.iterations = 50;
+        const uint64_t generation = leader.start(board, budget);
+
+        long helper_visits = 0;
+        std::optional<SharedJob> job;
+        std::thread helper_thread([&]() {
+            job = helper.next_job(0);
+            if (!job) {
+                return;
+            }
+            MCTS mcts(SearchConfig{.batch_size = 1, .threads = 1, .table_mb = 1});
+            mcts.ponder(job->board, job->budget);
+            auto stats = mcts.root_stats(job->board);
+            for (const auto& s : stats) {
+                helper_visits += s.visits;
+            }
+            helper.publish(job->generation, stats);
+        });
+
+        MCTS mcts(SearchConfig{.batch_size = 1, .threads = 1, .table_mb = 1});
+        mcts.ponder(board, budget);
+        long leader_visits = 0;
+        for (const auto& s : mcts.root_stats(board)) {
+            leader_visits += s.visits;
+        }
+        leader.publish(generation, mcts.root_stats(board));
+        REQUIRE(leader.wait(5000));
+        helper_thread.join();
+        REQUIRE(job);
+        REQUIRE(job->generation == generation);
+        REQUIRE(job->board.hash() == board.hash());
+
+        long merged_visits = 0;
+        for (const auto& s : leader.merged_stats(board)) {
+            merged_visits += s.visits;
+        }
+        REQUIRE(merged_visits == leader_visits + helper_visits);
+        REQUIRE(helper_visits > 0);
+    }
+
+    SECTION("The node table is shared") {
+        SharedSearch leader(name, 2, 0, 1);
+        REQUIRE(leader);
+        SharedSearch helper(name, 2, 1);
+        REQUIRE(helper);
+        REQUIRE(helper.table_mb() == 1);
+
+        SearchConfig config;
+        config.table_mb = 1;
+        MCTS leader_mcts(config, leader.table_memory(), true);
+        MCTS helper_mcts(config, helper.table_memory(), false);
+        leader_mcts.ponder(board, SearchBudget{0, 50});
+
+        auto leader_stats = leader_mcts.root_stats(board);
+        auto helper_stats = helper_mcts.root_stats(board);
+        REQUIRE(leader_stats.size() == helper_stats.size());
+        for (std::size_t i = 0; i < leader_stats.size(); ++i) {
+            REQUIRE(leader_stats[i].visits == helper_stats[i].visits);
+        }
+    }
+
+    SECTION("Jobs are never read half-written") {
+        auto leader = std::make_unique<SharedSearch>(name, 2, 0);
+        SharedSearch helper(name, 2, 1);
+        REQUIRE(helper);
+
+        // Each job's board and budget are derived from its generation
+        int n_jobs = 0;
+        int n_torn = 0;
+        std::thread helper_thread([&]() {
+            uint64_t last = 0;
+            while (auto job = helper.next_job(last)) {
+                last = job->generation;
+                ++n_jobs;
+                const uint64_t white = job->board.bitboard(Piece::WHITE);
+                if (white != 1ull << (job->generation % 48) || job->budget.iterations != long(job->generation)) {
+                    ++n_torn;
+                }
+            }
+        });
+        for (uint64_t generation = 1; generation <= 20000; ++generation) {
+            SearchBudget budget;
+            budget.iterations = generation;
+            leader->start(Board(1ull << (generation % 48), 1ull << 63, 0), budget);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        leader.reset();
+        helper_thread.join();
+        REQUIRE(n_jobs > 0);
+        REQUIRE(n_torn == 0);
+    }
+
+    SECTION("Helpers stop with the leader") {
+        auto leader = std::make_unique<SharedSearch>(name, 2, 0);
+        SharedSearch helper(name, 2, 1);
+        REQUIRE(helper);
+        leader.reset();
+        REQUIRE_FALSE(helper.next_job(0));
+    }
+}
+
+TEST_CASE("Sequential halving at the root", "[mcts]") {
+    // White to move with a pawn on e7, black far from promotion
+    Board board((1ull << 52) | (1ull << 8), (1ull << 63) | (1ull << 56), 0);
+
+    SearchConfig config;
+    config.root_policy = RootPolicy::SequentialHalving;
+    config.seed = 99;
+    StaticEvaluator evaluator;
+
+    SECTION("With an iteration budget") {
+        MCTS mcts(config);
+        mcts.set_evaluator(&evaluator);
+        SearchInfo info = mcts.ponder(board, SearchBudget{0, 400});
+        REQUIRE(info.iterations <= 400);
+        REQUIRE(info.iterations > 300);
+        Move move = mcts.choose_best(board);
+        REQUIRE(move.source == 52);
+        REQUIRE(move.target >= 56);
+    }
+
+    SECTION("With a time budget") {
+        MCTS mcts(config);
+        mcts.set_evaluator(&evaluator);
+        SearchInfo info = mcts.ponder(board, 50);
+        REQUIRE(info.ms < 200);
+        Move move = mcts.choose_best(board);
+        REQUIRE(move.source == 52);
+        REQUIRE(move.target >= 56);
+    }
+
+    SECTION("Every move is searched in the first round") {
+        MCTS mcts(config);
+        mcts.set_evaluator(&evaluator);
+        mcts.ponder(Board(), SearchBudget{0, 1000});
+        for (const auto& stats : mcts.root_stats(Board())) {
+            REQUIRE(stats.visits > 0);
+        }
+    }
+}
+
+TEST_CASE("Mirror symmetry", "[board][mcts]") {
+    auto mirror_files = [](uint64_t bitboard) {
+        uint64_t mirrored = 0;
+        for (int square = 0; square < 64; ++square) {
+            if (bitboard & (1ull << square)) {
+                mirrored |= 1ull << (square ^ 7);
+            }
+        }
+        return mirrored;
+    };
+
+    // Pawns on a2, b2 and f2 against pawns on c7 and h7
+    const uint64_t white = (1ull << 8) | (1ull << 9) | (1ull << 13);
+    const uint64_t black = (1ull << 50) | (1ull << 55);
+    Board board(white, black, 0);
+    Board mirrored(mirror_files(white), mirror_files(black), 0);
+
+    SECTION("A position and its mirror share their canonical hash") {
+        REQUIRE(board.hash() != mirrored.hash());
+        REQUIRE(board.mirror_hash() == mirrored.hash());
+        REQUIRE(mirrored.mirror_hash() == board.hash());
+        REQUIRE(board.canonical_hash() == mirrored.canonical_hash());
+        REQUIRE(Board().hash() == Board().mirror_hash());
+    }
+
+    SECTION("The mirror hash is kept up to date by play and unmake") {
+        MoveGen movegen;
+        const auto moves = movegen.valid_moves(board);
+        for (const auto& move : moves) {
+            const Move mirrored_move = mirror(move);
+            REQUIRE(board.canonical_hash_after(move) == mirrored.canonical_hash_after(mirrored_move));
+
+            const Piece captured = board.at(move.target);
+            board.play(move);
+            mirrored.play(mirrored_move);
+            REQUIRE(board.mirror_hash() == mirrored.hash());
+            REQUIRE(board.canonical_hash() == mirrored.canonical_hash());
+            mirrored.unmake(mirrored_move, captured);
+            board.unmake(move, captured);
+        }
+        REQUIRE(board.mirror_hash() == mirrored.hash());
+    }
+
+    SECTION("The search shares the statistics of mirrored positions") {
+        SearchConfig config;
+        config.symmetry = true;
+        config.root_policy = RootPolicy::SequentialHalving;
+        config.seed = 5;
+        StaticEvaluator evaluator;
+        MCTS mcts(config);
+        mcts.set_evaluator(&evaluator);
+        mcts.ponder(board, SearchBudget{0, 500});
+
+        const auto mirrored_stats = mcts.root_stats(mirrored);
+        for (const auto& stats : mcts.root_stats(board)) {
+            const Move mirrored_move = mirror(stats.move);
+            auto it = std::find_if(mirrored_stats.begin(), mirrored_stats.end(), [&](const RootStats& other) {
+                return other.move.source == mirrored_move.source && other.move.target == mirrored_move.target;
+            });
+            REQUIRE(it != mirrored_stats.end());
+            REQUIRE(it->visits == stats.visits);
+        }
+
+        // The move chosen for the searched position is mirrored back
+        const Move best = mcts.choose_best(board);
+        const Move mirrored_best = mcts.choose_best(mirrored);
+        REQUIRE(mirrored_best.source == mirror(best).source);
+        REQUIRE(mirrored_best.target == mirror(best).target);
+    }
+}
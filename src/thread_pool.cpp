@@ -0,0 +1,102 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace breakthrough {
+
+namespace {
+
+/**
+ * The pool and index of the worker running on this thread, if any.
+ */
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_index = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int n_threads) {
+    if (n_threads <= 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < n_threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < n_threads; ++i) {
+        m_threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    int index = current_pool == this ? current_index : m_next++ % m_workers.size();
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_queued;
+    }
+    m_cv.notify_one();
+}
+
+bool ThreadPool::pop(int index, Task& task) {
+    Worker& worker = *m_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(int index, Task& task) {
+    const int n = static_cast<int>(m_workers.size());
+    for (int offset = 1; offset < n; ++offset) {
+        Worker& victim = *m_workers[(index + offset) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(int index) {
+    current_pool = this;
+    current_index = index;
+
+    Task task;
+    while (true) {
+        if (pop(index, task) || steal(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_queued;
+            }
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_stop || m_queued > 0; });
+        if (m_stop && m_queued == 0) {
+            return;
+        }
+    }
+}
+
+}  // namespace breakthrough
@@ -0,0 +1,79 @@
+/**
+ * @file thread_pool.h
+ *
+ * A work-stealing thread pool.
+ *
+ * Each worker has its own deque of tasks: it runs them in order and, when
+ * it runs out, steals the most recent task of another worker. Tasks
+ * submitted from a worker go to its own deque, others are spread over
+ * the workers in turn.
+ *
+ * Running its own tasks in order lets a worker interleave tasks that
+ * requeue themselves, such as the time slices of concurrent searches.
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace breakthrough {
+
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * Start the given number of workers, one per core by default.
+     */
+    explicit ThreadPool(int n_threads = 0);
+
+    /**
+     * Run the tasks still queued, then stop the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task to be run by one of the workers.
+     */
+    void submit(Task task);
+
+    /**
+     * The number of workers.
+     */
+    int size() const { return static_cast<int>(m_workers.size()); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(int index, Task& task);
+    bool steal(int index, Task& task);
+    void run(int index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_queued{0};
+    bool m_stop{false};
+
+    std::atomic<unsigned> m_next{0};
+};
+
+}  // namespace breakthrough
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,372 @@
+/**
+ * @file ttable.h
+ *
+ * A fixed-size, lock-free transposition table keyed by position hashes.
+ *
+ * The table is an array of cache-line-sized buckets, each holding a few
+ * entries made of an atomic key and an atomic 8-byte value. A position is
+ * looked up in the bucket selected by the low bits of its hash, and the
+ * full hash is stored as the verification key to tell apart positions
+ * sharing a bucket. Values are updated with compare-and-swap, so any
+ * number of threads can read and update the table at once. No thread
+ * waits for another, so a process killed while sharing the table cannot
+ * block the others.
+ *
+ * When a bucket is full, the entry with the lowest priority is replaced,
+ * and its value is lost, which is acceptable for search statistics.
+ * Values are stored XORed with their key: an update racing with the
+ * replacement of its entry then fails its compare-and-swap instead of
+ * landing on the new key, and is retried on the key's own entry.
+ *
+ * The top bits of each key hold the generation of the table when the
+ * entry was written. Clearing the table starts a new generation, and
+ * entries of older generations are then treated as empty, so that the
+ * table is cleared in constant time.
+ */
+
+#ifndef TTABLE_H_
+#define TTABLE_H_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "arena.h"
+
+namespace breakthrough {
+
+template <typename Value, typename Priority>
+class TranspositionTable {
+    static_assert(sizeof(Value) == sizeof(uint64_t) && std::is_trivially_copyable_v<Value>,
+                  "Values must be stored in a single atomic word");
+
+public:
+    /**
+     * The number of entries in a bucket.
+     */
+    static constexpr int bucket_size = 4;
+
+    /**
+     * Allocate a table using about the given number of megabytes, in a
+     * memory arena placed as given on NUMA machines (see arena.h).
+     */
+    explicit TranspositionTable(std::size_t size_mb, NumaPlacement placement = NumaPlacement::Local)
+        : m_arena(bytes_for(size_mb), placement) {
+        attach(m_arena.data(), bytes_for(size_mb));
+        // The arena is zeroed: every entry is already of an old generation
+        clear();
+    }
+
+    /**
+     * Use the given memory, aligned on a cache line, instead of allocating
+     * it. The memory must outlive the table.
+     *
+     * Entries are kept as they are unless `initialize` is set, so that
+     * tables in different processes can share the same memory: the keys
+     * and values are lock-free atomics, which work across processes.
+     */
+    TranspositionTable(void* memory, std::size_t bytes, bool initialize) {
+        static_assert(std::atomic<uint64_t>::is_always_lock_free);
+        attach(memory, bytes);
+        if (initialize) {
+            wipe();
+        }
+    }
+
+    /**
+     * The number of bytes used by a table of about the given number of
+     * megabytes.
+     */
+    static std::size_t bytes_for(std::size_t size_mb) {
+        return bucket_count(size_mb << 20) * sizeof(Bucket);
+    }
+
+    /**
+     * The value stored for the key, or a default value if there is none.
+     */
+    Value probe(uint64_t hash) const {
+        const uint64_t key = to_key(hash, generation());
+        for (const Entry& entry : bucket(hash).entries) {
+            if (entry.key.load(std::memory_order_acquire) == key) {
+                uint64_t data = entry.data.load(std::memory_order_acquire);
+                // The entry may have been replaced while reading it
+                if (entry.key.load(std::memory_order_acquire) == key) {
+                    return decode(data, key);
+                }
+            }
+        }
+        return Value{};
+    }
+
+    /**
+     * Start loading the bucket of the key into the cache, ahead of a probe.
+     */
+    void prefetch(uint64_t hash) const {
+        __builtin_prefetch(&bucket(hash));
+    }
+
+    /**
+     * Atomically replace the value of the key by `f(value)`, inserting a
+     * default value first if the key is not in the table yet.
+     *
+     * The update is dropped, as if its entry had been replaced, in the
+     * unlikely case that every entry of the bucket is busy.
+     */
+    template <typename F>
+    void update(uint64_t hash, F&& f) {
+        const uint64_t key = to_key(hash, generation());
+        while (Entry* entry = find_or_insert(hash, key)) {
+            if (apply(*entry, key, f)) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Like `update`, but leave the table unchanged if the key is not in
+     * it. Returns whether the key was found.
+     */
+    template <typename F>
+    bool update_if_present(uint64_t hash, F&& f) {
+        const uint64_t key = to_key(hash, generation());
+        while (Entry* entry = find(hash, key)) {
+            if (apply(*entry, key, f)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Empty the table by starting a new generation. It must not be used by
+     * other threads meanwhile.
+     *
+     * Once every generation has been used, the entries are actually
+     * erased, which takes time proportional to the size of the table.
+     */
+    void clear() {
+        const uint64_t next = generation() + 1;
+        if (next > max_generation) {
+            wipe();
+        } else {
+            m_header->generation.store(next, std::memory_order_release);
+        }
+    }
+
+    /**
+     * The number of entries the table can hold.
+     */
+    std::size_t capacity() const { return m_mask * bucket_size; }
+
+private:
+    /**
+     * Reserved keys: an empty entry, and an entry being replaced. Both are
+     * of generation 0, which the table never has.
+     *
+     * Lookups skip busy entries rather than wait for them. A key inserted
+     * by two threads at once may then get a second entry, which is lost
+     * like a replaced one, and an entry left busy by a killed process is
+     * only reused once the table is wiped.
+     */
+    static constexpr uint64_t empty_key = 0;
+    static constexpr uint64_t busy_key = 1;
+
+    /**
+     * Keys keep the low bits of the hash, below the generation.
+     */
+    static constexpr int generation_shift = 56;
+    static constexpr uint64_t max_generation = (1ull << (64 - generation_shift)) - 1;
+    static constexpr uint64_t hash_mask = (1ull << generation_shift) - 1;
+
+    /**
+     * In the place of the last bucket, so that tables sharing their
+     * memory between processes also share their generation, and the table
+     * is exactly the size asked for.
+     */
+    struct alignas(64) Header {
+        std::atomic<uint64_t> generation;
+    };
+
+    struct Entry {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Entry entries[bucket_size];
+    };
+
+    /**
+     * The largest power of two number of buckets fitting in the bytes,
+     * counting the header, and at least 2.
+     */
+    static std::size_t bucket_count(std::size_t bytes) {
+        static_assert(sizeof(Header) == sizeof(Bucket));
+        std::size_t n_buckets = 2;
+        while (2 * n_buckets * sizeof(Bucket) <= bytes) {
+            n_buckets *= 2;
+        }
+        return n_buckets;
+    }
+
+    static uint64_t to_key(uint64_t hash, uint64_t generation) {
+        return (hash & hash_mask) | (generation << generation_shift);
+    }
+
+    static bool is_current(uint64_t key, uint64_t generation) {
+        return key >> generation_shift == generation;
+    }
+
+    uint64_t generation() const {
+        return m_header->generation.load(std::memory_order_acquire);
+    }
+
+    void attach(void* memory, std::size_t bytes) {
+        m_buckets = static_cast<Bucket*>(memory);
+        m_mask = bucket_count(bytes) - 1;
+        m_header = reinterpret_cast<Header*>(m_buckets + m_mask);
+    }
+
+    /**
+     * Erase every entry and restart from the first generation.
+     */
+    void wipe() {
+        for (std::size_t i = 0; i < m_mask; ++i) {
+            for (Entry& entry : m_buckets[i].entries) {
+                entry.key.store(empty_key, std::memory_order_relaxed);
+                entry.data.store(encode(Value{}, empty_key), std::memory_order_relaxed);
+            }
+        }
+        m_header->generation.store(1, std::memory_order_release);
+    }
+
+    static uint64_t encode(Value value, uint64_t key) {
+        return std::bit_cast<uint64_t>(value) ^ key;
+    }
+
+    static Value decode(uint64_t data, uint64_t key) {
+        return std::bit_cast<Value>(data ^ key);
+    }
+
+    /**
+     * The last bucket is the header, its keys go to the one before it.
+     */
+    Bucket& bucket(uint64_t hash) const {
+        const std::size_t index = hash & m_mask;
+        return m_buckets[index == m_mask ? index - 1 : index];
+    }
+
+    Entry* find(uint64_t hash, uint64_t key) const {
+        for (Entry& entry : bucket(hash).entries) {
+            if (entry.key.load(std::memory_order_acquire) == key) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * The entry of the key, inserted if needed, or nullptr if every entry
+     * of its bucket is busy.
+     */
+    Entry* find_or_insert(uint64_t hash, uint64_t key) {
+        const uint64_t current_generation = key >> generation_shift;
+        Bucket& b = bucket(hash);
+
+        while (true) {
+            // Look for the key, then claim the first empty or old entry
+            for (Entry& entry : b.entries) {
+                uint64_t current = entry.key.load(std::memory_order_acquire);
+                // Never wait for a claim to finish: its claimer may have
+                // been killed, in a process sharing the table
+                if (current == busy_key) {
+                    continue;
+                }
+                if (current == key) {
+                    return &entry;
+                }
+                if (!is_current(current, current_generation)) {
+                    if (claim(entry, current, key)) {
+                        return &entry;
+                    }
+                    // Lost the race, maybe to the same key
+                    if (entry.key.load(std::memory_order_acquire) == key) {
+                        return &entry;
+                    }
+                }
+            }
+
+            // The bucket is full: replace the entry with the lowest priority
+            Entry* victim = nullptr;
+            uint64_t victim_key = empty_key;
+            auto lowest = std::numeric_limits<decltype(Priority{}(Value{}))>::max();
+            int n_busy = 0;
+            for (Entry& entry : b.entries) {
+                uint64_t current = entry.key.load(std::memory_order_acquire);
+                if (!is_current(current, current_generation)) {
+                    n_busy += current == busy_key;
+                    continue;
+                }
+                auto priority = Priority{}(decode(entry.data.load(std::memory_order_relaxed), current));
+                if (!victim || priority < lowest) {
+                    victim = &entry;
+                    victim_key = current;
+                    lowest = priority;
+                }
+            }
+            if (victim && claim(*victim, victim_key, key)) {
+                return victim;
+            }
+            if (n_busy == bucket_size) {
+                return nullptr;
+            }
+        }
+    }
+
+    /**
+     * Replace the value of the entry by `f(value)`, unless the entry is
+     * given to another key first. Returns whether the value was replaced.
+     */
+    template <typename F>
+    static bool apply(Entry& entry, uint64_t key, F& f) {
+        uint64_t data = entry.data.load(std::memory_order_acquire);
+        // Reading the value of a new key guarantees that its key is seen
+        while (entry.key.load(std::memory_order_acquire) == key) {
+            if (entry.data.compare_exchange_weak(data, encode(f(decode(data, key)), key),
+                                                 std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Swap the key of an entry and reset its value, unless the entry
+     * changed in the meantime.
+     */
+    static bool claim(Entry& entry, uint64_t expected, uint64_t key) {
+        if (!entry.key.compare_exchange_strong(expected, busy_key, std::memory_order_acq_rel)) {
+            return false;
+        }
+        // Released so that updaters reading it also see the key change
+        entry.data.store(encode(Value{}, key), std::memory_order_release);
+        entry.key.store(key, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Empty if the memory was given to the table.
+     */
+    MemoryArena m_arena;
+
+    Header* m_header;
+    Bucket* m_buckets;
+    std::size_t m_mask;
+};
+
+}  // namespace breakthrough
+
+#endif // TTABLE_H_
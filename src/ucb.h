@@ -0,0 +1,104 @@
+/**
+ * @file ucb.h
+ *
+ * Selection of the child with the best UCB1 value.
+ *
+ * Selection runs once per ply of every iteration, so when the target has
+ * AVX2 the values of 8 children are computed at once. The scalar version
+ * is always available, and the two pick the same child.
+ */
+
+#ifndef UCB_H_
+#define UCB_H_
+
+#include "board.h"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace breakthrough {
+
+/**
+ * The statistics of the children of a node, gathered from the table into
+ * contiguous arrays. Entries past the last child, up to a multiple of 8,
+ * hold a reward of -infinity so that they are never selected.
+ */
+struct alignas(32) ChildStats {
+    static_assert(max_moves % 8 == 0, "children are padded to blocks of 8");
+    float visits[max_moves];
+    float rewards[max_moves];
+};
+
+/**
+ * The index of the first child with the best UCB1 value, unvisited
+ * children coming first.
+ */
+inline int argmax_ucb1_scalar(const ChildStats& children, int n_children, float log_parent_visits, float C) {
+    int best = 0;
+    float best_value = -std::numeric_limits<float>::infinity();
+    for (int i = 0; i < n_children; ++i) {
+        const float visits = children.visits[i];
+        const float value = visits == 0.0f
+            ? std::numeric_limits<float>::infinity()
+            : children.rewards[i] / visits + C * std::sqrt(log_parent_visits / visits);
+        if (value > best_value) {
+            best_value = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+#if defined(__AVX2__)
+/**
+ * argmax_ucb1_scalar, 8 children at a time.
+ */
+inline int argmax_ucb1_avx2(const ChildStats& children, int n_children, float log_parent_visits, float C) {
+    alignas(32) float values[max_moves];
+    const int n_blocks = (n_children + 7) / 8;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 log_parent = _mm256_set1_ps(log_parent_visits);
+    const __m256 exploration = _mm256_set1_ps(C);
+
+    __m256 best = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    for (int b = 0; b < n_blocks; ++b) {
+        const __m256 visits = _mm256_load_ps(children.visits + 8 * b);
+        const __m256 rewards = _mm256_load_ps(children.rewards + 8 * b);
+        __m256 value = _mm256_add_ps(_mm256_div_ps(rewards, visits),
+                                     _mm256_mul_ps(exploration, _mm256_sqrt_ps(_mm256_div_ps(log_parent, visits))));
+        value = _mm256_blendv_ps(value, infinity, _mm256_cmp_ps(visits, zero, _CMP_EQ_OQ));
+        _mm256_store_ps(values + 8 * b, value);
+        best = _mm256_max_ps(best, value);
+    }
+
+    // Broadcast the maximum to every lane, then find its first occurrence
+    best = _mm256_max_ps(best, _mm256_permute2f128_ps(best, best, 1));
+    best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+    for (int b = 0; b < n_blocks; ++b) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(values + 8 * b), best, _CMP_EQ_OQ));
+        if (mask) {
+            return 8 * b + std::countr_zero(static_cast<unsigned>(mask));
+        }
+    }
+    return 0;
+}
+#endif
+
+inline int argmax_ucb1(const ChildStats& children, int n_children, float log_parent_visits, float C) {
+#if defined(__AVX2__)
+    return argmax_ucb1_avx2(children, n_children, log_parent_visits, C);
+#else
+    return argmax_ucb1_scalar(children, n_children, log_parent_visits, C);
+#endif
+}
+
+}  // namespace breakthrough
+
+#endif // UCB_H_
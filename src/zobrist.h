@@ -1,13 +1,21 @@
 #ifndef ZOBRIST_H_
 #define ZOBRIST_H_
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <random>
-#include <unordered_map>
 
 namespace breakthrough {
 
 class Zobrist {
 public:
+    /**
+     * Keys are below this bound. Hashes are updated for every child of
+     * every node selected, so the values are in a flat array.
+     */
+    static constexpr int max_keys = 512;
+
     /**
      * Seed the random number generator.
      */
@@ -16,21 +24,25 @@ public:
     /**
      * Generate a random value at the given key.
      */
-    void generate(int key) { m_table[key] = m_rng(); }
+    void generate(int key) {
+        m_size += m_table[key] == 0;
+        m_table[key] = m_rng();
+    }
 
     /**
      * Retrieve the value associated to the given key.
      */
-    uint64_t operator[](int key) { return m_table[key]; }
+    uint64_t operator[](int key) const { return m_table[key]; }
 
     /**
      * Check if the values have been generated.
      */
-    size_t size() const { return m_table.size(); }
+    size_t size() const { return m_size; }
 
 private:
     std::mt19937_64 m_rng;
-    std::unordered_map<int, uint64_t> m_table;
+    std::array<uint64_t, max_keys> m_table{};
+    size_t m_size{0};
 };
 
 }  // namespace breakthrough
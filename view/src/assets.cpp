@@ -13,10 +13,7 @@ Assets::Assets() : status{true}
     black_pawn_.setTexture(black_pawn_texture);
 }
 
-namespace
-{
-
-sf::Vector2f get_position(breakthrough::Square square)
+sf::Vector2f square_position(breakthrough::Square square)
 {
     float row = static_cast<int>(square / 8);
     float file = square % 8;
@@ -27,18 +24,16 @@ sf::Vector2f get_position(breakthrough::Square square)
     return position + conf::board_border_size + conf::board_position;
 }
 
-}
-
 const sf::Sprite& Assets::white_pawn(breakthrough::Square square)
 {
-    sf::Vector2f position = get_position(square);
+    sf::Vector2f position = square_position(square);
     white_pawn_.setPosition(position);
     return white_pawn_;
 }
 
 const sf::Sprite& Assets::black_pawn(breakthrough::Square square)
 {
-    sf::Vector2f position = get_position(square);
+    sf::Vector2f position = square_position(square);
     black_pawn_.setPosition(position);
     return black_pawn_;
 }
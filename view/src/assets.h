@@ -5,6 +5,11 @@
 #include "board.h"
 #include <SFML/Graphics.hpp>
 
+/**
+ * The window position of the top-left corner of a square.
+ */
+sf::Vector2f square_position(breakthrough::Square square);
+
 class Assets
 {
 public:
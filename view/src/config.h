@@ -21,6 +21,13 @@ namespace conf
 
     // Board configuration
     const sf::Vector2f board_position = (window_size_f - board_size) * 0.5f;
+
+    // Search configuration
+    const int search_time_ms = 1000;
+
+    // Search overlay configuration
+    const uint8_t overlay_max_alpha = 160;
+    const float overlay_bar_height = 5.0f;
 }
 
 #endif // CONFIG_H_
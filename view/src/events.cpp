@@ -1,14 +1,16 @@
 #include "events.h"
 #include "config.h"
-#include "mcts.h"
 #include <iostream>
 
-void processEvents(sf::Window& window, breakthrough::Board& board)
+void processEvents(sf::Window& window, breakthrough::Board& board, BackgroundSearch& search)
 {
-    static breakthrough::MCTS mcts;
     static breakthrough::Move move = {-1, -1};
 
-    static bool should_ponder = false;
+    if (auto computer_move = search.poll())
+    {
+        std::cout << "Computer move: " << "source: " << computer_move->source << ", target: " << computer_move->target << std::endl;
+        board.play(*computer_move);
+    }
 
     for (auto event = sf::Event{}; window.pollEvent(event);)
     {
@@ -23,16 +25,10 @@ void processEvents(sf::Window& window, breakthrough::Board& board)
                 window.close();
             }
         }
-        else if (should_ponder)
+        else if (search.active())
         {
-            mcts.ponder(board, 1000);
-            move = mcts.choose_best(board);
-
-            std::cout << "Computer move: " << "source: " << move.source << ", target: " << move.target << std::endl;
-
-            board.play(move);
-            should_ponder = false;
-            move = {-1, -1};
+            // Ignore the player while the computer is thinking
+            continue;
         }
         else if (event.type == sf::Event::MouseButtonPressed)
         {
@@ -61,7 +57,8 @@ void processEvents(sf::Window& window, breakthrough::Board& board)
                     move.target = idx;
                     std::cout << "Player move: " << "source: " << move.source << ", target: " << move.target << std::endl;
                     board.play(move);
-                    should_ponder = true;
+                    move = {-1, -1};
+                    search.start(board, conf::search_time_ms);
                 }
             }
         }
@@ -3,7 +3,8 @@
 
 #include <SFML/Window.hpp>
 #include "board.h"
+#include "search.h"
 
-void processEvents(sf::Window& window, breakthrough::Board& board);
+void processEvents(sf::Window& window, breakthrough::Board& board, BackgroundSearch& search);
 
 #endif // EVENTS_H_
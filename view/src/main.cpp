@@ -3,6 +3,8 @@
 #include "config.h"
 #include "assets.h"
 #include "board.h"
+#include "overlay.h"
+#include "search.h"
 #include <iostream>
 #include <vector>
 
@@ -19,10 +21,11 @@ int main()
     }
 
     breakthrough::Board game;
+    BackgroundSearch search;
 
     while (window.isOpen())
     {
-        processEvents(window, game);
+        processEvents(window, game, search);
 
         window.clear(sf::Color{120, 120, 120});
         window.draw(assets.board());
@@ -41,6 +44,11 @@ int main()
             }
         }
 
+        if (search.active())
+        {
+            draw_search_overlay(window, search.stats());
+        }
+
         window.display();
     }
 }
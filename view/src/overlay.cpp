@@ -0,0 +1,47 @@
+#include "overlay.h"
+#include "assets.h"
+#include "config.h"
+#include <algorithm>
+#include <array>
+
+void draw_search_overlay(sf::RenderTarget& target, const std::vector<breakthrough::RootStats>& stats)
+{
+    // Several moves can reach the same square, aggregate them
+    std::array<int, 64> visits{};
+    std::array<double, 64> reward{};
+    for (const auto& s : stats)
+    {
+        visits[s.move.target] += s.visits;
+        reward[s.move.target] += s.value * s.visits;
+    }
+
+    int max_visits = *std::max_element(visits.begin(), visits.end());
+    if (max_visits == 0)
+    {
+        return;
+    }
+
+    sf::RectangleShape heat(conf::pawn_size);
+    sf::RectangleShape bar;
+    for (breakthrough::Square square = 0; square < 64; ++square)
+    {
+        if (visits[square] == 0)
+        {
+            continue;
+        }
+        const sf::Vector2f position = square_position(square);
+        const float share = static_cast<float>(visits[square]) / max_visits;
+        const double value = reward[square] / visits[square];
+
+        heat.setPosition(position);
+        heat.setFillColor(sf::Color(255, 200, 0, static_cast<sf::Uint8>(share * conf::overlay_max_alpha)));
+        target.draw(heat);
+
+        const auto red = static_cast<sf::Uint8>(std::clamp(127.5 * (1.0 - value), 0.0, 255.0));
+        const auto green = static_cast<sf::Uint8>(std::clamp(127.5 * (1.0 + value), 0.0, 255.0));
+        bar.setSize({conf::pawn_size.x * share, conf::overlay_bar_height});
+        bar.setPosition(position + sf::Vector2f{0.f, conf::pawn_size.y - conf::overlay_bar_height});
+        bar.setFillColor(sf::Color(red, green, 0));
+        target.draw(bar);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef OVERLAY_H_
+#define OVERLAY_H_
+
+#include "mcts.h"
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+/**
+ * Draw the root statistics of a running search over the board: the more
+ * visits the moves to a square got, the more opaque it is, and a bar at
+ * the bottom of the square shows their value, from red (losing) to green
+ * (winning) for the computer.
+ */
+void draw_search_overlay(sf::RenderTarget& target, const std::vector<breakthrough::RootStats>& stats);
+
+#endif // OVERLAY_H_
@@ -0,0 +1,42 @@
+#include "search.h"
+
+BackgroundSearch::~BackgroundSearch()
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void BackgroundSearch::start(const breakthrough::Board& board, int ms)
+{
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    root = board;
+    done = false;
+    worker = std::thread([this, ms]() {
+        mcts.ponder(root, ms);
+        done = true;
+    });
+}
+
+std::optional<breakthrough::Move> BackgroundSearch::poll()
+{
+    if (!worker.joinable() || !done)
+    {
+        return std::nullopt;
+    }
+    worker.join();
+    return mcts.choose_best(root);
+}
+
+std::vector<breakthrough::RootStats> BackgroundSearch::stats() const
+{
+    if (!worker.joinable())
+    {
+        return {};
+    }
+    return mcts.root_stats(root);
+}
@@ -0,0 +1,52 @@
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include "board.h"
+#include "mcts.h"
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs the engine's search on a background thread so that the window
+ * keeps rendering and handling input while the computer thinks.
+ */
+class BackgroundSearch
+{
+public:
+    BackgroundSearch() = default;
+    ~BackgroundSearch();
+
+    BackgroundSearch(const BackgroundSearch&) = delete;
+    BackgroundSearch& operator=(const BackgroundSearch&) = delete;
+
+    /**
+     * Start searching the given position for the given time.
+     */
+    void start(const breakthrough::Board& board, int ms);
+
+    /**
+     * Check if a search was started and has not been collected yet.
+     */
+    bool active() const { return worker.joinable(); }
+
+    /**
+     * The best move once the search is over, collected only once.
+     */
+    std::optional<breakthrough::Move> poll();
+
+    /**
+     * The current statistics of the root moves, safe to call while the
+     * search runs.
+     */
+    std::vector<breakthrough::RootStats> stats() const;
+
+private:
+    breakthrough::MCTS mcts;
+    breakthrough::Board root;
+    std::thread worker;
+    std::atomic<bool> done{false};
+};
+
+#endif // SEARCH_H_